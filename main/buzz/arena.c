@@ -0,0 +1,118 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ARENA_FIRST_BLOCK (64 * 1024)
+#define ARENA_MAX_BLOCK (16 * 1024 * 1024)
+#define ARENA_ALIGN sizeof(void *)
+
+void arena_init(Arena *arena) {
+    arena->head = NULL;
+    arena->next_size = ARENA_FIRST_BLOCK;
+}
+
+// Start a new block big enough for 'size' bytes; blocks double up to ARENA_MAX_BLOCK
+static ArenaBlock *arena_grow(Arena *arena, size_t size) {
+    size_t block_size = arena->next_size;
+    if (block_size < size) {
+        block_size = size;
+    }
+
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + block_size);
+    if (!block) {
+        perror("Failed to allocate memory for arena");
+        exit(EXIT_FAILURE);
+    }
+
+    block->size = block_size;
+    block->used = 0;
+    block->next = arena->head;
+    arena->head = block;
+
+    if (arena->next_size < ARENA_MAX_BLOCK) {
+        arena->next_size *= 2;
+    }
+    return block;
+}
+
+static void *arena_bump(Arena *arena, size_t size, size_t align) {
+    ArenaBlock *block = arena->head;
+    size_t offset = 0;
+
+    if (block) {
+        offset = (block->used + align - 1) & ~(align - 1);
+    }
+    if (!block || offset + size > block->size) {
+        block = arena_grow(arena, size);
+        offset = 0;
+    }
+
+    block->used = offset + size;
+    return block->data + offset;
+}
+
+// Pointer-aligned allocation that lives until arena_free()
+void *arena_alloc(Arena *arena, size_t size) {
+    return arena_bump(arena, size, ARENA_ALIGN);
+}
+
+// NUL-terminated copy of the first 'length' bytes of text
+char *arena_strndup(Arena *arena, const char *text, size_t length) {
+    char *copy = arena_bump(arena, length + 1, 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+// Hand every block of 'from' over to 'into', leaving 'from' empty
+void arena_merge(Arena *into, Arena *from) {
+    if (!from->head) {
+        return;
+    }
+
+    // Keep the block being filled in front so later allocations still use its free space
+    ArenaBlock *tail = from->head;
+    while (tail->next) {
+        tail = tail->next;
+    }
+
+    if (into->head) {
+        tail->next = into->head->next;
+        into->head->next = from->head;
+    } else {
+        into->head = from->head;
+    }
+
+    from->head = NULL;
+}
+
+// Forget every allocation but keep the block being filled for the next round
+void arena_reset(Arena *arena) {
+    if (!arena->head) {
+        return;
+    }
+
+    ArenaBlock *block = arena->head->next;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+}
+
+void arena_free(Arena *arena) {
+    ArenaBlock *block = arena->head;
+
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->head = NULL;
+    arena->next_size = ARENA_FIRST_BLOCK;
+}
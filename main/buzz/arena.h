@@ -0,0 +1,27 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator: many small allocations, one release
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;        // Bytes available in data
+    size_t used;        // Bytes handed out so far
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;   // Block currently being filled; older blocks follow
+    size_t next_size;   // Size of the next block to allocate
+} Arena;
+
+// Function Prototypes
+void arena_init(Arena *arena);
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strndup(Arena *arena, const char *text, size_t length);
+void arena_merge(Arena *into, Arena *from);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+
+#endif
@@ -0,0 +1,666 @@
+#define _XOPEN_SOURCE 700
+
+#include "batch.h"
+#include "hash.h"
+#include "lex.h"
+#include "source.h"
+#include "output.h"
+#include "parallel.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#define real_path(path) _fullpath(NULL, path, 0)
+#else
+#define make_dir(path) mkdir(path, 0777)
+#define real_path(path) realpath(path, NULL)
+#endif
+
+#define BATCH_EXTENSION ".bz"
+
+// Per-worker deque of file indices plus what the worker got through
+typedef struct {
+    pthread_mutex_t lock;
+    size_t *queue;      // Indices into the batch, smallest file first
+    size_t head;        // Next index a thief takes
+    size_t tail;        // One past the next index the owner takes
+    unsigned long long remaining; // Bytes of the files still queued
+
+    size_t files;
+    size_t failed;
+    size_t stolen;
+    size_t cached;      // Files replayed from the token cache
+    unsigned long long bytes;
+    unsigned long long tokens;
+    double busy;        // Seconds spent lexing and writing
+} BatchWorker;
+
+typedef struct {
+    BatchList *list;
+    BatchWorker *workers;
+    int worker_count;
+} BatchPool;
+
+typedef struct {
+    BatchPool *pool;
+    int id;
+} BatchThread;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *join_path(const char *dir, const char *name) {
+    size_t dir_len = strlen(dir);
+    char *path = malloc(dir_len + strlen(name) + 2);
+    if (!path) {
+        perror("Failed to allocate memory for path");
+        exit(EXIT_FAILURE);
+    }
+
+    strcpy(path, dir);
+    if (dir_len > 0 && dir[dir_len - 1] != '/' && dir[dir_len - 1] != '\\') {
+        strcat(path, "/");
+    }
+    strcat(path, name);
+    return path;
+}
+
+static int has_extension(const char *path, const char *extension) {
+    const char *dot = strrchr(path, '.');
+    return dot && strcmp(dot, extension) == 0;
+}
+
+static const char *base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    const char *backslash = strrchr(path, '\\');
+    if (backslash > slash) {
+        slash = backslash;
+    }
+    return slash ? slash + 1 : path;
+}
+
+// Create every missing parent directory of 'path'
+static int make_parent_dirs(const char *path) {
+    char *copy = strdup(path);
+    if (!copy) {
+        return -1;
+    }
+
+    for (char *p = copy + 1; *p; p++) {
+        if (*p != '/' && *p != '\\') {
+            continue;
+        }
+        char separator = *p;
+        *p = '\0';
+        if (make_dir(copy) != 0 && errno != EEXIST) {
+            free(copy);
+            return -1;
+        }
+        *p = separator;
+    }
+
+    free(copy);
+    return 0;
+}
+
+// A file's identity for the identities index: entries are file * 2 for an input, file * 2 + 1 for its output
+typedef struct {
+    dev_t device;
+    ino_t inode;
+    int output;
+} FileIdentity;
+
+typedef int (*SameEntry)(const BatchList *list, uint32_t entry, const void *key);
+
+static int same_output(const BatchList *list, uint32_t entry, const void *key) {
+    return strcmp(list->files[entry].output, key) == 0;
+}
+
+static int same_identity(const BatchList *list, uint32_t entry, const void *key) {
+    const FileIdentity *identity = key;
+    const BatchFile *file = &list->files[entry / 2];
+    if ((int)(entry & 1) != identity->output) {
+        return 0;
+    }
+    return entry & 1 ? file->output_device == identity->device && file->output_inode == identity->inode
+                     : file->device == identity->device && file->inode == identity->inode;
+}
+
+static uint32_t identity_hash(const FileIdentity *identity) {
+    return (uint32_t)hash64(&identity->inode, sizeof(identity->inode), (uint64_t)identity->device);
+}
+
+// Double the slots, keeping the index at most half full
+static void grow_index(BatchIndex *index) {
+    uint32_t slot_count = index->slots ? (index->mask + 1) * 2 : 256;
+    uint64_t *slots = calloc(slot_count, sizeof(uint64_t));
+    if (!slots) {
+        perror("Failed to allocate memory for batch index");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0; index->slots && i <= index->mask; i++) {
+        if (index->slots[i] != 0) {
+            uint32_t j = (uint32_t)(index->slots[i] >> 32) & (slot_count - 1);
+            while (slots[j] != 0) {
+                j = (j + 1) & (slot_count - 1);
+            }
+            slots[j] = index->slots[i];
+        }
+    }
+
+    free(index->slots);
+    index->slots = slots;
+    index->mask = slot_count - 1;
+}
+
+static uint32_t slot_entry(const uint64_t *slot) {
+    return (uint32_t)*slot - 1;
+}
+
+// Slot of the entry with 'hash' that 'same' accepts for 'key', or the empty slot where it would go
+static uint64_t *find_entry(const BatchList *list, BatchIndex *index, uint32_t hash, SameEntry same, const void *key) {
+    if (index->count * 2 >= index->mask) { // Also true before the first slots exist
+        grow_index(index);
+    }
+
+    for (uint32_t i = hash & index->mask;; i = (i + 1) & index->mask) {
+        uint64_t *slot = &index->slots[i];
+        if (*slot == 0 || ((uint32_t)(*slot >> 32) == hash && same(list, slot_entry(slot), key))) {
+            return slot;
+        }
+    }
+}
+
+static void set_entry(BatchIndex *index, uint64_t *slot, uint32_t hash, uint32_t entry) {
+    *slot = (uint64_t)hash << 32 | (entry + 1);
+    index->count++;
+}
+
+/* Add 'input' to be written to 'output' (taken over by the list). Refused
+   when another input already writes 'output', or when 'output' is an input
+   under any name: it is truncated while that input is still being read. */
+static int add_file(BatchList *list, const char *input, char *output, const struct stat *info) {
+    uint32_t file = (uint32_t)list->count;
+    uint32_t output_hash = (uint32_t)hash64(output, strlen(output), 0);
+    uint64_t *output_slot = find_entry(list, &list->outputs, output_hash, same_output, output);
+    if (*output_slot != 0) {
+        fprintf(stderr, "Error: '%s' and '%s' would both be written to '%s'.\n",
+                list->files[slot_entry(output_slot)].input, input, output);
+        free(output);
+        return -1;
+    }
+
+    if (make_parent_dirs(output) != 0) {
+        fprintf(stderr, "Error: Unable to create directory for '%s'.\n", output);
+        free(output);
+        return -1;
+    }
+
+    // Inode 0 means the platform has no file identity, so only the paths can be compared
+    FileIdentity from = {info->st_dev, info->st_ino, 0};
+    FileIdentity to = {0, 0, 1};
+    struct stat existing;
+    if (stat(output, &existing) == 0) {
+        to.device = existing.st_dev;
+        to.inode = existing.st_ino;
+    }
+
+    uint64_t *slot;
+    if (to.inode != 0 && to.device == from.device && to.inode == from.inode) {
+        fprintf(stderr, "Error: Output '%s' would overwrite input '%s'.\n", output, input);
+        free(output);
+        return -1;
+    }
+    if (to.inode != 0) {
+        FileIdentity as_input = {to.device, to.inode, 0};
+        if (*(slot = find_entry(list, &list->identities, identity_hash(&as_input), same_identity, &as_input)) != 0) {
+            fprintf(stderr, "Error: Output '%s' would overwrite input '%s'.\n", output, list->files[slot_entry(slot) / 2].input);
+            free(output);
+            return -1;
+        }
+        if (*(slot = find_entry(list, &list->identities, identity_hash(&to), same_identity, &to)) != 0) {
+            fprintf(stderr, "Error: '%s' and '%s' would both be written to '%s'.\n",
+                    list->files[slot_entry(slot) / 2].input, input, output);
+            free(output);
+            return -1;
+        }
+    }
+    if (from.inode != 0) {
+        FileIdentity as_output = {from.device, from.inode, 1};
+        if (*(slot = find_entry(list, &list->identities, identity_hash(&as_output), same_identity, &as_output)) != 0) {
+            fprintf(stderr, "Error: Output '%s' would overwrite input '%s'.\n", list->files[slot_entry(slot) / 2].output, input);
+            free(output);
+            return -1;
+        }
+    }
+
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        BatchFile *files = realloc(list->files, sizeof(BatchFile) * capacity);
+        if (!files) {
+            perror("Failed to allocate memory for batch");
+            exit(EXIT_FAILURE);
+        }
+        list->files = files;
+        list->capacity = capacity;
+    }
+
+    BatchFile *added = &list->files[list->count++];
+    added->input = strdup(input);
+    added->output = output;
+    added->size = (size_t)info->st_size;
+    added->device = from.device;
+    added->inode = from.inode;
+    added->output_device = to.device;
+    added->output_inode = to.inode;
+    if (!added->input) {
+        perror("Failed to allocate memory for batch");
+        exit(EXIT_FAILURE);
+    }
+
+    set_entry(&list->outputs, output_slot, output_hash, file);
+    if (from.inode != 0 && *(slot = find_entry(list, &list->identities, identity_hash(&from), same_identity, &from)) == 0) {
+        set_entry(&list->identities, slot, identity_hash(&from), file * 2); // The same input named twice is kept once
+    }
+    if (to.inode != 0) {
+        slot = find_entry(list, &list->identities, identity_hash(&to), same_identity, &to);
+        set_entry(&list->identities, slot, identity_hash(&to), file * 2 + 1);
+    }
+    return 0;
+}
+
+// Collect every .bz file below 'dir', mirroring the tree under 'output_dir'
+static int add_directory(BatchList *list, const char *dir, const char *output_dir) {
+    DIR *handle = opendir(dir);
+    if (!handle) {
+        fprintf(stderr, "Error: Unable to open directory '%s'.\n", dir);
+        return -1;
+    }
+
+    int status = 0;
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+
+        char *input = join_path(dir, entry->d_name);
+        char *output = join_path(output_dir, entry->d_name);
+        struct stat info;
+
+        if (stat(input, &info) != 0) {
+            fprintf(stderr, "Error: Unable to read '%s'.\n", input);
+            status = -1;
+        } else if (S_ISDIR(info.st_mode)) {
+            if (add_directory(list, input, output) != 0) {
+                status = -1;
+            }
+        } else if (S_ISREG(info.st_mode) && has_extension(input, BATCH_EXTENSION)) {
+            if (add_file(list, input, output, &info) != 0) {
+                status = -1;
+            }
+            output = NULL; // Owned by the list now
+        }
+
+        free(output);
+        free(input);
+    }
+
+    closedir(handle);
+    return status;
+}
+
+// Read one path per line from a file list
+static int add_list(BatchList *list, const char *list_path, const char *output_dir) {
+    FILE *file = fopen(list_path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Unable to open file list '%s'.\n", list_path);
+        return -1;
+    }
+
+    int status = 0;
+    char path[4096];
+    while (fgets(path, sizeof(path), file)) {
+        path[strcspn(path, "\r\n")] = '\0';
+        if (path[0] == '\0') {
+            continue;
+        }
+        if (batch_add(list, path, output_dir) != 0) {
+            status = -1;
+        }
+    }
+
+    fclose(file);
+    return status;
+}
+
+// Where a directory named on the command line goes under output_dir: a directory of its own name
+// (looked up for "." and ".."), or output_dir itself for the root directory
+static char *root_output(const char *dir, const char *output_dir) {
+    char *name = strdup(dir);
+    if (!name) {
+        perror("Failed to allocate memory for path");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t length = strlen(name);
+    while (length > 1 && (name[length - 1] == '/' || name[length - 1] == '\\')) {
+        name[--length] = '\0';
+    }
+    if (strcmp(base_name(name), ".") == 0 || strcmp(base_name(name), "..") == 0) {
+        char *real = real_path(dir);
+        if (real) {
+            free(name);
+            name = real;
+        }
+    }
+
+    char *output = join_path(output_dir, base_name(name));
+    free(name);
+    return output;
+}
+
+// Add a .bz file, a directory tree or an @file-list to the batch
+int batch_add(BatchList *list, const char *path, const char *output_dir) {
+    if (path[0] == '@') {
+        return add_list(list, path + 1, output_dir);
+    }
+
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        fprintf(stderr, "Error: Unable to open file '%s'.\n", path);
+        return -1;
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+        char *output = root_output(path, output_dir);
+        int status = add_directory(list, path, output);
+        free(output);
+        return status;
+    }
+
+    if (!has_extension(path, BATCH_EXTENSION)) {
+        fprintf(stderr, "Error: Invalid file type '%s'. Expected '%s'.\n", path, BATCH_EXTENSION);
+        return -1;
+    }
+
+    return add_file(list, path, join_path(output_dir, base_name(path)), &info);
+}
+
+void batch_free(BatchList *list) {
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->files[i].input);
+        free(list->files[i].output);
+    }
+    free(list->files);
+    free(list->outputs.slots);
+    free(list->identities.slots);
+
+    list->files = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    memset(&list->outputs, 0, sizeof(list->outputs));
+    memset(&list->identities, 0, sizeof(list->identities));
+}
+
+// Largest first, so a big file never starts last and holds up the end of the run
+static int compare_size_desc(const void *a, const void *b) {
+    const BatchFile *left = a;
+    const BatchFile *right = b;
+    return (left->size < right->size) - (left->size > right->size);
+}
+
+/* Pop the largest file left at the tail of our own deque. Once it is empty,
+   steal the smallest file from the head of the deque with the most bytes
+   left, so the owner keeps its big files and thieves even out the end. */
+static int take_work(BatchPool *pool, int id, size_t *item) {
+    BatchWorker *self = &pool->workers[id];
+    const BatchFile *files = pool->list->files;
+    int found = 0;
+
+    pthread_mutex_lock(&self->lock);
+    if (self->head < self->tail) {
+        *item = self->queue[--self->tail];
+        self->remaining -= files[*item].size;
+        found = 1;
+    }
+    pthread_mutex_unlock(&self->lock);
+    if (found) {
+        return 1;
+    }
+
+    for (;;) {
+        BatchWorker *victim = NULL;
+        unsigned long long most = 0;
+
+        for (int k = 1; k < pool->worker_count; k++) {
+            BatchWorker *w = &pool->workers[(id + k) % pool->worker_count];
+            pthread_mutex_lock(&w->lock);
+            if (w->head < w->tail && (!victim || w->remaining > most)) {
+                victim = w;
+                most = w->remaining;
+            }
+            pthread_mutex_unlock(&w->lock);
+        }
+        if (!victim) {
+            return 0; // Every deque is empty, and nothing is ever added back
+        }
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail) {
+            *item = victim->queue[victim->head++];
+            victim->remaining -= files[*item].size;
+            found = 1;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if (found) {
+            self->stolen++;
+            return 1;
+        }
+        // The victim emptied its deque meanwhile: pick again
+    }
+}
+
+static void lex_batch_file(BatchWorker *self, LexerState *state, BatchFile *file, OutputFormat format, TokenCache *cache) {
+    SourceBuffer source;
+    if (source_open(&source, file->input) != 0) {
+        fprintf(stderr, "Error: Unable to open file '%s'.\n", file->input);
+        self->failed++;
+        return;
+    }
+
+    size_t token_count = 0;
+    Token *tokens = NULL;
+    uint64_t key = 0;
+    if (cache) {
+        key = cache_key(cache, source.data, source.length);
+        tokens = cache_load(cache, key, state, source.data, source.length, &token_count);
+    }
+    if (tokens) {
+        self->cached++;
+    } else {
+        lexer_reset(state, source.data, source.length);
+        lexer_reserve(state, LEX_PREDICT_TOKENS(source.length)); // Largest files come first, so this soon stops allocating
+        while (lexNext(state)) {
+            // Tokens go straight into the worker's array
+        }
+        tokens = lexer_finish(state, &token_count);
+        if (lexer_error(state)) {
+            char reason[128];
+            lex_error_describe(state, reason, sizeof(reason));
+            fprintf(stderr, "Error: '%s': %s\n", file->input, reason);
+            source_close(&source);
+            self->failed++;
+            return;
+        }
+        if (cache) {
+            cache_store(cache, key, source.data, tokens, token_count);
+        }
+    }
+
+    // Only a file that lexed gets an output, and a failed write leaves none behind
+    FILE *out = fopen(file->output, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Unable to create file '%s'.\n", file->output);
+        source_close(&source);
+        self->failed++;
+        return;
+    }
+    int written = write_tokens(out, format, source.data, tokens);
+    if (fclose(out) != 0 || written != 0) {
+        fprintf(stderr, "Error: Unable to write file '%s'.\n", file->output);
+        remove(file->output);
+        source_close(&source);
+        self->failed++;
+        return;
+    }
+
+    self->files++;
+    self->bytes += source.length;
+    self->tokens += token_count;
+    source_close(&source);
+}
+
+static void *batch_worker(void *arg) {
+    BatchThread *thread = arg;
+    BatchPool *pool = thread->pool;
+    BatchWorker *self = &pool->workers[thread->id];
+    LexerState state;
+    size_t item;
+
+    // One state for every file the worker takes, reset in between like a server worker's
+    lexer_init(&state, NULL, 0);
+    while (take_work(pool, thread->id, &item)) {
+        double start = now_seconds();
+        lex_batch_file(self, &state, &pool->list->files[item], pool->list->format, pool->list->cache);
+        self->busy += now_seconds() - start;
+    }
+    lexer_free(&state);
+
+    return NULL;
+}
+
+static void write_report(FILE *report, BatchWorker *workers, int worker_count, double wall) {
+    size_t files = 0, failed = 0, stolen = 0, cached = 0;
+    unsigned long long bytes = 0, tokens = 0;
+
+    fprintf(report, "%-8s %8s %8s %14s %12s %10s %10s\n",
+            "WORKER", "FILES", "STOLEN", "BYTES", "TOKENS", "BUSY (s)", "MB/s");
+    fprintf(report, "------------------------------------------------------------------------\n");
+
+    for (int i = 0; i < worker_count; i++) {
+        BatchWorker *w = &workers[i];
+        fprintf(report, "%-8d %8zu %8zu %14llu %12llu %10.3f %10.2f\n",
+                i, w->files, w->stolen, w->bytes, w->tokens, w->busy,
+                w->busy > 0 ? w->bytes / w->busy / 1e6 : 0.0);
+
+        files += w->files;
+        failed += w->failed;
+        stolen += w->stolen;
+        cached += w->cached;
+        bytes += w->bytes;
+        tokens += w->tokens;
+    }
+
+    fprintf(report, "------------------------------------------------------------------------\n");
+    fprintf(report, "%-8s %8zu %8zu %14llu %12llu %10.3f %10.2f\n",
+            "TOTAL", files, stolen, bytes, tokens, wall,
+            wall > 0 ? bytes / wall / 1e6 : 0.0);
+
+    if (cached > 0) {
+        fprintf(report, "%zu file(s) replayed from the token cache.\n", cached);
+    }
+    if (failed > 0) {
+        fprintf(report, "%zu file(s) failed.\n", failed);
+    }
+}
+
+// Lex every file of the batch on 'workers' threads; returns the number of files that failed
+int batch_run(BatchList *list, int workers, FILE *report) {
+    if (workers < 1) {
+        workers = 1;
+    }
+    if ((size_t)workers > list->count && list->count > 0) {
+        workers = (int)list->count;
+    }
+
+    // Sorting moves the files the indexes point at, so nothing more can be added from here on
+    free(list->outputs.slots);
+    free(list->identities.slots);
+    memset(&list->outputs, 0, sizeof(list->outputs));
+    memset(&list->identities, 0, sizeof(list->identities));
+    qsort(list->files, list->count, sizeof(BatchFile), compare_size_desc);
+
+    BatchPool pool;
+    pool.list = list;
+    pool.worker_count = workers;
+    pool.workers = calloc(workers, sizeof(BatchWorker));
+    BatchThread *threads = malloc(sizeof(BatchThread) * workers);
+    pthread_t *ids = malloc(sizeof(pthread_t) * workers);
+    if (!pool.workers || !threads || !ids) {
+        perror("Failed to allocate memory for workers");
+        exit(EXIT_FAILURE);
+    }
+
+    // Deal files round-robin so every deque starts with its share of the large ones,
+    // smallest first so each owner's tail holds its largest
+    for (int i = 0; i < workers; i++) {
+        BatchWorker *w = &pool.workers[i];
+        pthread_mutex_init(&w->lock, NULL);
+        w->queue = malloc(sizeof(size_t) * (list->count / workers + 1));
+        if (!w->queue) {
+            perror("Failed to allocate memory for work queue");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t i = list->count; i-- > 0;) {
+        BatchWorker *w = &pool.workers[i % workers];
+        w->queue[w->tail++] = i;
+        w->remaining += list->files[i].size;
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < workers; i++) {
+        threads[i].pool = &pool;
+        threads[i].id = i;
+        if (pthread_create(&ids[i], NULL, batch_worker, &threads[i]) != 0) {
+            perror("Failed to start worker thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < workers; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    double wall = now_seconds() - start;
+
+    size_t failed = 0;
+    for (int i = 0; i < workers; i++) {
+        failed += pool.workers[i].failed;
+    }
+    if (report) {
+        write_report(report, pool.workers, workers, wall);
+    }
+
+    for (int i = 0; i < workers; i++) {
+        pthread_mutex_destroy(&pool.workers[i].lock);
+        free(pool.workers[i].queue);
+    }
+    free(pool.workers);
+    free(threads);
+    free(ids);
+
+    return (int)failed;
+}
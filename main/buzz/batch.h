@@ -0,0 +1,45 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "output.h"
+#include "cache.h"
+
+// One input file of a batch run and where its token table is written
+typedef struct {
+    char *input;
+    char *output;
+    size_t size;
+    dev_t device;           // Identity of the input, and of the output when it already exists
+    ino_t inode;            // (inode 0: unknown, e.g. on Windows)
+    dev_t output_device;
+    ino_t output_inode;
+} BatchFile;
+
+// Open addressing over the files of a batch: hash << 32 | (entry + 1) per slot, 0 for an empty slot
+typedef struct {
+    uint64_t *slots;
+    uint32_t mask;          // Slot count - 1 (a power of two)
+    uint32_t count;
+} BatchIndex;
+
+typedef struct {
+    BatchFile *files;
+    size_t count;
+    size_t capacity;
+    OutputFormat format;    // How every output file is written
+    TokenCache *cache;      // Token files of inputs seen before, or NULL
+    BatchIndex outputs;     // Output paths, so no two inputs write the same file
+    BatchIndex identities;  // Inputs and existing outputs by device and inode, so no output overwrites an input
+} BatchList;
+
+// Function Prototypes
+int batch_add(BatchList *list, const char *path, const char *output_dir);
+int batch_run(BatchList *list, int workers, FILE *report);
+void batch_free(BatchList *list);
+
+#endif
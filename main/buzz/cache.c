@@ -0,0 +1,237 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "cache.h"
+#include "hash.h"
+#include "tokenfile.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#include <sys/utime.h>
+#define make_dir(path) _mkdir(path)
+#define touch(path) _utime(path, NULL)
+#define process_id() _getpid()
+#else
+#include <unistd.h>
+#include <utime.h>
+#define make_dir(path) mkdir(path, 0777)
+#define touch(path) utime(path, NULL)
+#define process_id() getpid()
+#endif
+
+// Temporary files written by this process so far, numbering the next one
+static atomic_ulong temporaries;
+
+// One file found in the cache directory while trimming
+typedef struct {
+    char *path;
+    off_t size;
+    time_t used;
+} CacheEntry;
+
+static char *cache_path(const TokenCache *cache, uint64_t key, const char *suffix) {
+    size_t length = strlen(cache->dir) + 16 + strlen(suffix) + 2;
+    char *path = malloc(length);
+    if (!path) {
+        perror("Failed to allocate memory for path");
+        exit(EXIT_FAILURE);
+    }
+
+    snprintf(path, length, "%s/%016llx%s", cache->dir, (unsigned long long)key, suffix);
+    return path;
+}
+
+// Create the cache directory; -1 if it does not exist and cannot be made
+int cache_open(TokenCache *cache, const char *dir, size_t limit) {
+    if (make_dir(dir) != 0 && errno != EEXIST) {
+        return -1;
+    }
+
+    cache->dir = strdup(dir);
+    if (!cache->dir) {
+        perror("Failed to allocate memory for cache");
+        exit(EXIT_FAILURE);
+    }
+    cache->limit = limit;
+
+    // Every token name and spelling feeds the seed, so editing keywords.def retires old files
+    uint64_t seed = hash64(TOKEN_FILE_MAGIC, 4, (uint64_t)TOKEN_CACHE_VERSION << 16 | TOKEN_FILE_VERSION);
+    for (int type = 0; type < END_OF_TOKENS; type++) {
+        const char *name = token_name((TokenType)type);
+        const char *spelling = token_spelling((TokenType)type);
+        seed = hash64(name, strlen(name), seed);
+        if (spelling) {
+            seed = hash64(spelling, strlen(spelling), seed);
+        }
+    }
+    cache->seed = seed;
+    return 0;
+}
+
+uint64_t cache_key(const TokenCache *cache, const char *source, size_t length) {
+    return hash64(source, length, cache->seed);
+}
+
+/* Replay the cached tokens of 'source' into 'state' as if it had been lexed.
+   The state comes from lexer_init or an earlier input and is reset here, so a
+   warm state keeps its buffers; release it with lexer_free either way. Every
+   token is checked against the source, so a hash collision or a damaged file
+   is a miss. NULL on a miss. */
+Token *cache_load(TokenCache *cache, uint64_t key, LexerState *state, const char *source, size_t length, size_t *token_count) {
+    char *path = cache_path(cache, key, TOKEN_FILE_EXTENSION);
+    TokenReader reader;
+
+    if (token_reader_open(&reader, path) != 0) {
+        free(path);
+        return NULL;
+    }
+
+    lexer_reset(state, source, length);
+    // The header's count is only trusted as far as the source could hold that many tokens
+    lexer_reserve(state, reader.count <= length + 1 ? (size_t)reader.count : LEX_PREDICT_TOKENS(length));
+
+    Token token;
+    const char *text;
+    int status;
+    while ((status = token_reader_next(&reader, &token, &text)) == 1) {
+        if (token.offset > length || token.length > length - token.offset ||
+            memcmp(source + token.offset, text, token.length) != 0) {
+            status = -1;
+            break;
+        }
+        lexer_append(state, &token, 1);
+    }
+    token_reader_close(&reader);
+
+    if (status != 0) {
+        free(path);
+        return NULL;
+    }
+
+    touch(path); // Mark as recently used for cache_trim
+    free(path);
+
+    state->cursor = state->source_end;
+    return lexer_finish(state, token_count);
+}
+
+/* Save the tokens of 'source' under 'key'. The file is written under a
+   temporary name of its own (process ID and a counter) and renamed, so
+   readers never see half a file and concurrent writers of the same key do
+   not collide; the last rename wins. */
+int cache_store(TokenCache *cache, uint64_t key, const char *source, const Token *tokens, size_t count) {
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%ld-%lu.tmp", (long)process_id(), atomic_fetch_add(&temporaries, 1));
+    char *temporary = cache_path(cache, key, suffix);
+    char *path = cache_path(cache, key, TOKEN_FILE_EXTENSION);
+    int status = -1;
+
+    FILE *out = fopen(temporary, "wbx");
+    if (out) {
+        status = token_file_write(out, source, tokens, count);
+        if (fclose(out) != 0) {
+            status = -1;
+        }
+        if (status != 0 || rename(temporary, path) != 0) {
+            remove(temporary);
+            status = -1;
+        }
+    }
+
+    free(temporary);
+    free(path);
+    return status;
+}
+
+// Least recently used first
+static int compare_used(const void *a, const void *b) {
+    const CacheEntry *left = a;
+    const CacheEntry *right = b;
+    return (left->used > right->used) - (left->used < right->used);
+}
+
+/* Remove the temporary files of writers that died before renaming them, then
+   the least recently used token files until the cache fits its limit; -1 if
+   the directory cannot be read */
+int cache_trim(TokenCache *cache) {
+    DIR *handle = opendir(cache->dir);
+    if (!handle) {
+        return -1;
+    }
+
+    CacheEntry *entries = NULL;
+    size_t count = 0, capacity = 0;
+    unsigned long long total = 0;
+    time_t stale = time(NULL) - TOKEN_CACHE_STALE;
+    struct dirent *entry;
+
+    while ((entry = readdir(handle)) != NULL) {
+        const char *dot = strrchr(entry->d_name, '.');
+        if (!dot || (strcmp(dot, TOKEN_FILE_EXTENSION) != 0 && strcmp(dot, ".tmp") != 0)) {
+            continue;
+        }
+
+        size_t length = strlen(cache->dir) + strlen(entry->d_name) + 2;
+        char *path = malloc(length);
+        struct stat info;
+        if (!path) {
+            perror("Failed to allocate memory for path");
+            exit(EXIT_FAILURE);
+        }
+        snprintf(path, length, "%s/%s", cache->dir, entry->d_name);
+        if (stat(path, &info) != 0 || !S_ISREG(info.st_mode)) {
+            free(path);
+            continue;
+        }
+
+        // A recent temporary file may still be being written: leave it to its writer
+        if (strcmp(dot, ".tmp") == 0) {
+            if (info.st_mtime < stale) {
+                remove(path);
+            }
+            free(path);
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            CacheEntry *grown = realloc(entries, sizeof(CacheEntry) * capacity);
+            if (!grown) {
+                perror("Failed to allocate memory for cache entries");
+                exit(EXIT_FAILURE);
+            }
+            entries = grown;
+        }
+        entries[count].path = path;
+        entries[count].size = info.st_size;
+        entries[count].used = info.st_mtime;
+        count++;
+        total += (unsigned long long)info.st_size;
+    }
+    closedir(handle);
+
+    qsort(entries, count, sizeof(CacheEntry), compare_used);
+    for (size_t i = 0; i < count; i++) {
+        if (total > cache->limit && remove(entries[i].path) == 0) {
+            total -= (unsigned long long)entries[i].size;
+        }
+        free(entries[i].path);
+    }
+
+    free(entries);
+    return 0;
+}
+
+void cache_close(TokenCache *cache) {
+    free(cache->dir);
+    cache->dir = NULL;
+}
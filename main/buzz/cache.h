@@ -0,0 +1,33 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lex.h"
+
+// Bump whenever the lexer produces different tokens for the same input
+// 2: an invalid '#' or '~' run no longer stops at a 0xFF byte
+#define TOKEN_CACHE_VERSION 2
+#define TOKEN_CACHE_LIMIT ((size_t)256 << 20)
+// Seconds after which cache_trim takes a temporary file for one a crashed writer left behind
+#define TOKEN_CACHE_STALE 3600
+
+/* Directory of binary token files (.bzt), one per distinct input, named by
+   the hash of the input's bytes, its length and the lexer's version. The
+   least recently used files are removed once the directory is over 'limit'. */
+typedef struct {
+    char *dir;
+    size_t limit;       // Bytes the cache may hold after cache_trim
+    uint64_t seed;      // Lexer version and token table; stale files never match
+} TokenCache;
+
+// Function Prototypes
+int cache_open(TokenCache *cache, const char *dir, size_t limit);
+uint64_t cache_key(const TokenCache *cache, const char *source, size_t length);
+Token *cache_load(TokenCache *cache, uint64_t key, LexerState *state, const char *source, size_t length, size_t *token_count);
+int cache_store(TokenCache *cache, uint64_t key, const char *source, const Token *tokens, size_t count);
+int cache_trim(TokenCache *cache);
+void cache_close(TokenCache *cache);
+
+#endif
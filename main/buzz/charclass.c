@@ -0,0 +1,23 @@
+#include "charclass.h"
+
+#define IS_ALPHA(c) (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z'))
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+#define CLASS_OF(c) ( \
+    (IS_ALPHA(c) ? CHAR_IDENT_START : 0) | \
+    (IS_ALPHA(c) || IS_DIGIT(c) || (c) == '_' ? CHAR_IDENT_CONT : 0) | \
+    (IS_DIGIT(c) ? CHAR_DIGIT : 0) | \
+    ((c) == ' ' || ((c) >= '\t' && (c) <= '\r') ? CHAR_SPACE : 0) | \
+    ((c) == '\n' ? CHAR_NEWLINE : 0) | \
+    ((c) == '+' || (c) == '-' || (c) == '*' || (c) == '/' || (c) == '%' || (c) == '^' || \
+     (c) == '=' || (c) == '<' || (c) == '>' || (c) == '!' || (c) == '&' || (c) == '|' ? CHAR_OPERATOR : 0) | \
+    ((c) == '#' || (c) == '~' ? CHAR_SIGIL : 0))
+
+// Expand CLASS_OF for every byte value, so the table is written out by the compiler
+#define CLASS_4(c) CLASS_OF(c), CLASS_OF((c) + 1), CLASS_OF((c) + 2), CLASS_OF((c) + 3)
+#define CLASS_16(c) CLASS_4(c), CLASS_4((c) + 4), CLASS_4((c) + 8), CLASS_4((c) + 12)
+#define CLASS_64(c) CLASS_16(c), CLASS_16((c) + 16), CLASS_16((c) + 32), CLASS_16((c) + 48)
+
+const unsigned char char_class_table[256] = {
+    CLASS_64(0), CLASS_64(64), CLASS_64(128), CLASS_64(192)
+};
@@ -0,0 +1,23 @@
+#ifndef CHARCLASS_H
+#define CHARCLASS_H
+
+#include <stdio.h>
+
+// Class bits of a source byte; a byte can have several
+#define CHAR_IDENT_START 0x01  // A-Z, a-z
+#define CHAR_IDENT_CONT  0x02  // Letters, digits and '_'
+#define CHAR_DIGIT       0x04  // 0-9
+#define CHAR_SPACE       0x08  // ' ', '\t', '\n', '\v', '\f', '\r'
+#define CHAR_NEWLINE     0x10  // '\n'
+#define CHAR_OPERATOR    0x20  // First character of an operator: + - * / % ^ = < > ! & |
+#define CHAR_SIGIL       0x40  // '#' and '~' in front of identifiers
+
+// Fixed ASCII classification, independent of the C locale
+extern const unsigned char char_class_table[256];
+
+// Class bits of a character as returned by getNextChar/peekChar; EOF has none
+static inline int charClass(int ch) {
+    return ch == EOF ? 0 : char_class_table[(unsigned char)ch];
+}
+
+#endif
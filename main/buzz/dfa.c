@@ -0,0 +1,77 @@
+#include "dfa.h"
+
+#define DFA_MAX_PARTS 3     // Keep in step with MAX_PARTS in tools/dfa_gen.c
+
+// Tokens one rule stores: fixed-length parts plus at most one taking the rest of the match
+typedef struct {
+    unsigned char skip;     // Match is dropped (blanks)
+    unsigned char parts;
+    struct {
+        TokenType type;
+        unsigned int length;    // 0 for the part that takes the rest
+    } part[DFA_MAX_PARTS];
+} DfaRule;
+
+#include "dfa_table.h"
+
+
+/* Table-driven lexer built from table/tokens.spec: every token is the
+   longest match of the generated DFA, with no per-character branching on
+   token kinds. Produces the same tokens as lex_buffer; rebuild
+   dfa_table.h with tools/dfa_gen after changing the spec or keywords.def. */
+Token *lex_dfa(LexerState *state, const char *source, size_t length, size_t *token_count) {
+    const char *end = source + length;
+    const char *p = source;
+
+    lexer_init(state, source, length);
+    lexer_start(state);
+    lexer_reserve(state, LEX_PREDICT_TOKENS(length));
+    STAT_ADD(state, bytes, length);
+    STAT_START(started);
+
+    while (p < end) {
+        // Run the automaton as far as it goes, remembering the last accepting state
+        const char *q = p;
+        const char *match = p + 1;
+        int rule = -1;
+        int s = DFA_START;
+
+        while (q < end && (s = dfa_next[s][dfa_class[(unsigned char)*q]]) != DFA_DEAD) {
+            q++;
+            if (dfa_accept[s] >= 0) {
+                rule = dfa_accept[s];
+                match = q;
+            }
+        }
+
+        // A byte no rule matches is invalid on its own (the spec ends in a catch-all, so this is a fallback)
+        static const DfaRule unmatched = {0, 1, {{INVALID, 0}}};
+        const DfaRule *r = rule >= 0 ? &dfa_rules[rule] : &unmatched;
+
+        if (!r->skip) {
+            size_t rest = match - p;
+            for (int i = 0; i < r->parts; i++) {
+                rest -= r->part[i].length;
+            }
+
+            const char *at = p;
+            for (int i = 0; i < r->parts; i++) {
+                state->token_start = at;
+                state->lexeme_index = r->part[i].length ? r->part[i].length : rest;
+                storeToken(state, r->part[i].type);
+                at += state->lexeme_index;
+            }
+
+            // A token too long to store ends the input, as it does for lexNext
+            if (lexer_error(state)) {
+                break;
+            }
+        }
+
+        p = match;
+    }
+
+    STAT_STOP(state, PHASE_CLASSIFY, started);
+    state->cursor = end;
+    return lexer_finish(state, token_count);
+}
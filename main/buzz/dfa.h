@@ -0,0 +1,11 @@
+#ifndef DFA_H
+#define DFA_H
+
+#include <stddef.h>
+
+#include "lex.h"
+
+// Function Prototypes
+Token *lex_dfa(LexerState *state, const char *source, size_t length, size_t *token_count);
+
+#endif
@@ -0,0 +1,331 @@
+#include "incremental.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Run holding document token 'index' (index < document->count)
+static size_t run_of(const LexDocument *document, size_t index) {
+    size_t low = 0, high = document->run_count;
+
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (document->runs[mid].first <= index) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Token 'index' with its offset in the current text
+void lex_document_token(const LexDocument *document, size_t index, Token *token) {
+    const TokenRun *run = &document->runs[run_of(document, index)];
+    *token = run->tokens[index - run->first];
+    token->offset += run->shift;
+}
+
+// Tokens that lexNext stores together with the token before them
+static int continues_group(const Token *previous, const Token *token) {
+    if (token->type == COMMENT || token->type == COMMENT_END) {
+        return 1;
+    }
+    return token->type == NOISE_WORD && previous->type == RETURN_TOKEN &&
+           token->offset == previous->offset + previous->length; // "returnvalue"
+}
+
+static int continues_at(const LexDocument *document, size_t index) {
+    Token previous, token;
+    if (index == 0 || index >= document->count) {
+        return 0;
+    }
+    lex_document_token(document, index - 1, &previous);
+    lex_document_token(document, index, &token);
+    return continues_group(&previous, &token);
+}
+
+static size_t group_start(const LexDocument *document, size_t index) {
+    while (continues_at(document, index)) {
+        index--;
+    }
+    return index;
+}
+
+// First token whose spelling ends at or after 'offset'
+static size_t first_ending_at(const LexDocument *document, size_t offset) {
+    size_t low = 0, high = document->count;
+    Token token;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        lex_document_token(document, mid, &token);
+        if (token.offset + token.length < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Token that starts a group exactly at 'offset', or document->count if none does
+static size_t find_group(const LexDocument *document, size_t offset) {
+    size_t low = 0, high = document->count;
+    Token token;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        lex_document_token(document, mid, &token);
+        if (token.offset < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low < document->count) {
+        lex_document_token(document, low, &token);
+        if (token.offset == offset && !continues_at(document, low)) {
+            return low;
+        }
+    }
+    return document->count;
+}
+
+static void add_block(LexDocument *document, Token *tokens) {
+    if (document->block_count == document->block_capacity) {
+        size_t capacity = document->block_capacity ? document->block_capacity * 2 : 16;
+        Token **blocks = realloc(document->blocks, sizeof(Token *) * capacity);
+        if (!blocks) {
+            perror("Failed to allocate memory for document");
+            exit(EXIT_FAILURE);
+        }
+        document->blocks = blocks;
+        document->block_capacity = capacity;
+    }
+    document->blocks[document->block_count++] = tokens;
+}
+
+static void add_run(TokenRun **runs, size_t *count, size_t *capacity, const TokenRun *run) {
+    if (run->count == 0) {
+        return;
+    }
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        TokenRun *grown = realloc(*runs, sizeof(TokenRun) * *capacity);
+        if (!grown) {
+            perror("Failed to allocate memory for document");
+            exit(EXIT_FAILURE);
+        }
+        *runs = grown;
+    }
+    (*runs)[(*count)++] = *run;
+}
+
+// Copy every token out with its current offset, ending in an END_OF_TOKENS marker; the caller frees the array
+Token *lex_document_tokens(const LexDocument *document, size_t *token_count) {
+    Token *tokens = malloc(sizeof(Token) * (document->count + 1));
+    if (!tokens) {
+        perror("Failed to allocate memory for tokens");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t r = 0; r < document->run_count; r++) {
+        const TokenRun *run = &document->runs[r];
+        Token *out = tokens + run->first;
+        memcpy(out, run->tokens, sizeof(Token) * run->count);
+        for (size_t i = 0; i < run->count; i++) {
+            out[i].offset += run->shift;
+        }
+    }
+
+    Token *end = &tokens[document->count];
+    memset(end, 0, sizeof(Token));
+    end->type = END_OF_TOKENS;
+    end->offset = document->state.source_end - document->state.source;
+    *token_count = document->count;
+    return tokens;
+}
+
+// Gather the runs into one array, releasing every block the edits left behind
+static void compact(LexDocument *document) {
+    size_t count;
+    Token *tokens = lex_document_tokens(document, &count);
+
+    for (size_t i = 0; i < document->block_count; i++) {
+        free(document->blocks[i]);
+    }
+    document->block_count = 0;
+    add_block(document, tokens);
+
+    document->run_count = 0;
+    TokenRun run = {tokens, count, 0, 0};
+    add_run(&document->runs, &document->run_count, &document->run_capacity, &run);
+}
+
+// Point the document's state at 'source' and move it to 'at', with an empty token array
+static void restart(LexerState *state, const char *source, size_t length, size_t at) {
+    state->source = source;
+    state->cursor = source + at;
+    state->source_end = source + length;
+    state->stop = state->source_end;
+    state->token_start = state->cursor;
+    scan_reset(&state->scan);
+
+    state->tokens = NULL;
+    state->tokens_index = 0;
+    state->tokens_capacity = 0;
+    state->pending_index = 0;
+    state->lexeme_index = 0;
+
+    state->tokens_stored = 0;
+    memset(&state->error, 0, sizeof(state->error));
+    lexer_limit(state, &state->limits);
+}
+
+/* Lex 'source' as the document's first text. Returns 0, or -1 when a
+   token was too long to store (lexer_error(&document->state) says where);
+   the document then holds the tokens before it. The source may be freed
+   once the next edit has replaced it. */
+int lex_document_open(LexDocument *document, const char *source, size_t length) {
+    size_t count;
+
+    memset(document, 0, sizeof(*document));
+    Token *tokens = lex_parallel(&document->state, source, length, 0, &count);
+    document->state.tokens = NULL;
+    document->state.tokens_capacity = 0;
+    document->state.tokens_index = 0;
+    symbols_keep_names(&document->state.symbols, 0, &document->state.arena);
+
+    add_block(document, tokens);
+    TokenRun run = {tokens, count, 0, 0};
+    add_run(&document->runs, &document->run_count, &document->run_capacity, &run);
+    document->count = count;
+    document->changed_first = 0;
+    document->changed_count = count;
+    return lexer_error(&document->state) ? -1 : 0;
+}
+
+/* Replace tokens [keep, sync) with 'count' new ones, moving the runs from
+   'sync' on by 'shift'. Only run boundaries are touched, never tokens. */
+static void splice(LexDocument *document, size_t keep, size_t sync, Token *tokens, size_t count, size_t shift) {
+    TokenRun *runs = NULL;
+    size_t run_count = 0, run_capacity = 0;
+
+    // Runs are in token order, so every piece before the edit comes ahead of every piece after it
+    for (size_t r = 0; r < document->run_count && document->runs[r].first < keep; r++) {
+        TokenRun run = document->runs[r];
+        if (run.first + run.count > keep) {
+            run.count = keep - run.first;
+        }
+        add_run(&runs, &run_count, &run_capacity, &run);
+    }
+
+    TokenRun fresh = {tokens, count, keep, 0};
+    add_run(&runs, &run_count, &run_capacity, &fresh);
+
+    for (size_t r = 0; r < document->run_count; r++) {
+        TokenRun run = document->runs[r];
+        if (run.first + run.count <= sync) {
+            continue;
+        }
+        size_t skip = run.first < sync ? sync - run.first : 0;
+        run.tokens += skip;
+        run.count -= skip;
+        run.first = run.first + skip - sync + keep + count;
+        run.shift += shift;
+        add_run(&runs, &run_count, &run_capacity, &run);
+    }
+
+    free(document->runs);
+    document->runs = runs;
+    document->run_count = run_count;
+    document->run_capacity = run_capacity;
+    document->count = keep + count + (document->count - sync);
+}
+
+/* Bring the document up to date with 'source', the text after 'edit'. Old
+   groups that end (with the character the lexer peeks after them) before
+   the edit are kept. Lexing restarts at the last of them and stops as soon
+   as a group starts where an old group after the edit did; the runs from
+   there on only change their shift. Returns 0, or -1 as lex_document_open
+   does; changed_first and changed_count say which tokens are new. */
+int lex_edit(LexDocument *document, const char *source, size_t length, const LexEdit *edit) {
+    LexerState *state = &document->state;
+    size_t old_edit_end = edit->offset + edit->deleted;
+    size_t new_edit_end = edit->offset + edit->inserted;
+    size_t old_count = document->count;
+    uint32_t symbols = state->symbols.count;
+    Token token;
+
+    // Restart at the start of the last untouched group, where the lexer is known to be between tokens
+    size_t keep = group_start(document, first_ending_at(document, edit->offset));
+    size_t at = 0;
+    if (keep > 0) {
+        keep = group_start(document, keep - 1);
+        lex_document_token(document, keep, &token);
+        at = token.offset;
+    }
+
+    restart(state, source, length, at);
+    lexer_reserve(state, LEX_PREDICT_TOKENS(edit->inserted));
+
+    // Relex until the new stream lines up with an old group past the edit
+    size_t sync = old_count;
+    for (;;) {
+        skipBlanks(state);
+        if (state->cursor >= state->source_end) {
+            break;
+        }
+
+        at = state->cursor - source;
+        if (at >= new_edit_end) {
+            sync = find_group(document, at - new_edit_end + old_edit_end);
+            if (sync < old_count) {
+                break;
+            }
+        }
+        lexNext(state);
+        if (lexer_error(state)) {
+            break; // A token too long to store: nothing after it is kept
+        }
+    }
+
+    size_t shift = 0;
+    if (sync < old_count) {
+        lex_document_token(document, sync, &token);
+        shift = at - token.offset;
+    }
+
+    size_t count = state->tokens_index;
+    if (count > 0) {
+        add_block(document, state->tokens);
+    } else {
+        free(state->tokens);
+    }
+    splice(document, keep, sync, state->tokens, count, shift);
+    state->tokens = NULL;
+    state->tokens_capacity = 0;
+    state->tokens_index = 0;
+
+    // Names seen for the first time may sit in text the caller frees after the next edit
+    symbols_keep_names(&state->symbols, symbols, &state->arena);
+
+    document->changed_first = keep;
+    document->changed_count = count;
+    if (document->run_count > LEX_DOCUMENT_MAX_RUNS || document->block_count > LEX_DOCUMENT_MAX_RUNS) {
+        compact(document);
+    }
+    return lexer_error(state) ? -1 : 0;
+}
+
+void lex_document_free(LexDocument *document) {
+    for (size_t i = 0; i < document->block_count; i++) {
+        free(document->blocks[i]);
+    }
+    free(document->blocks);
+    free(document->runs);
+    lexer_free(&document->state);
+    memset(document, 0, sizeof(*document));
+}
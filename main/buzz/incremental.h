@@ -0,0 +1,54 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stddef.h>
+
+#include "lex.h"
+
+// Runs or token arrays a document may hold before an edit gathers its tokens into one array again
+// (an edit adds at most two runs and one array, so the tokens are copied once every few hundred edits)
+#define LEX_DOCUMENT_MAX_RUNS 1024
+
+// One edit to a lexed buffer: 'deleted' bytes at 'offset' replaced by 'inserted' bytes
+typedef struct {
+    size_t offset;
+    size_t deleted;
+    size_t inserted;
+} LexEdit;
+
+// Consecutive tokens of a document, stored 'shift' bytes behind the text they now belong to
+typedef struct {
+    const Token *tokens;    // Into one of the document's blocks
+    size_t count;
+    size_t first;           // Index of tokens[0] in the document
+    size_t shift;           // Added to every stored offset (modulo SIZE_MAX + 1, so text can move back)
+} TokenRun;
+
+/* Tokens of a buffer that is lexed once and then edited. An edit lexes only
+   the groups around it again: the tokens before and after it stay in the
+   arrays they were stored in, and the runs after it just move by the edit's
+   length. Identifiers keep their symbol IDs across edits; new names get the
+   next ones, and names an edit deleted keep theirs. So unlike lex(), IDs
+   stop following first appearance after an edit, and the symbol table may
+   hold names no token uses any more. */
+typedef struct {
+    LexerState state;       // Symbol table and arena of every edit; its token array is unused between edits
+    TokenRun *runs;
+    size_t run_count;
+    size_t run_capacity;
+    Token **blocks;         // Every token array the runs point into
+    size_t block_count;
+    size_t block_capacity;
+    size_t count;           // Tokens in all runs
+    size_t changed_first;   // The last edit replaced tokens from here on...
+    size_t changed_count;   // ...with this many freshly lexed ones
+} LexDocument;
+
+// Function Prototypes
+int lex_document_open(LexDocument *document, const char *source, size_t length);
+int lex_edit(LexDocument *document, const char *source, size_t length, const LexEdit *edit);
+void lex_document_token(const LexDocument *document, size_t index, Token *token);
+Token *lex_document_tokens(const LexDocument *document, size_t *token_count);
+void lex_document_free(LexDocument *document);
+
+#endif
@@ -0,0 +1,39 @@
+// Generated by tools/keyword_gen.c from keywords.def - do not edit
+
+#define KEYWORD_HASH_SIZE 128
+#define KEYWORD_HASH(first, last, length) \
+    (((unsigned int)(first) * 4u + (unsigned int)(last) * 30u + (unsigned int)(length)) & (KEYWORD_HASH_SIZE - 1))
+
+static const KeywordSlot keyword_hash[KEYWORD_HASH_SIZE] = {
+    [1] = {"hover", 5, HOVER_TOKEN},
+    [2] = {"switch", 6, SWITCH_TOKEN},
+    [14] = {"elseif", 6, ELSEIF_TOKEN},
+    [20] = {"do", 2, DO_TOKEN},
+    [24] = {"downto", 6, DOWNTO_TOKEN},
+    [26] = {"if", 2, IF_TOKEN},
+    [32] = {"is", 2, IS_TOKEN},
+    [34] = {"queenbee", 8, QUEENBEE_TOKEN},
+    [38] = {"size", 4, SIZE_TOKEN},
+    [39] = {"buzzout", 7, BUZZOUT_TOKEN},
+    [42] = {"true", 4, TRUE_TOKEN},
+    [50] = {"return", 6, RETURN_TOKEN},
+    [52] = {"bool", 4, BOOL_TOKEN},
+    [53] = {"float", 5, FLOAT_TOKEN},
+    [55] = {"while", 5, WHILE_TOKEN},
+    [63] = {"int", 3, INT_TOKEN},
+    [73] = {"returns", 7, RETURNS_TOKEN},
+    [78] = {"this", 4, THIS_TOKEN},
+    [88] = {"buzz", 4, BUZZ_TOKEN},
+    [90] = {"upto", 4, UPTO_TOKEN},
+    [99] = {"sting", 5, STING_TOKEN},
+    [101] = {"beegone", 7, BEEGONE_TOKEN},
+    [102] = {"case", 4, CASE_TOKEN},
+    [108] = {"char", 4, CHAR_TOKEN},
+    [110] = {"else", 4, ELSE_TOKEN},
+    [114] = {"beegin", 6, BEEGIN_TOKEN},
+    [115] = {"false", 5, FALSE_TOKEN},
+    [117] = {"chain", 5, CHAIN_TOKEN},
+    [119] = {"for", 3, FOR_TOKEN},
+    [122] = {"hive", 4, HIVE_TOKEN},
+    [126] = {"gather", 6, GATHER_TOKEN},
+};
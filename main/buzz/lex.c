@@ -1,620 +1,609 @@
 #include "lex.h"
+#include "source.h"
+#include "charclass.h"
+#include "literal.h"
+#include "lines.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
-
-unsigned int line = 1;
-unsigned int column = 0;
-
-int tokens_index = 0;
-int lexeme_index = 0;
-int char_class;
 
 #define COMMENT_CLASS 0
 #define LETTER 1
 #define DIGIT 2
 #define OTHER 3
-#define RETURN_TOKEN 1
-#define NOISE_WORD 2
-#define COMMENT_BEGIN 1001
-#define COMMENT_END 1003
-#define INCREMENT 1
-#define DECREMENT -1
 
+#define INITIAL_TOKENS 12 // Placeholder value for number of tokens
+
+// Name of every token type, and its spelling when the type fixes the text
+typedef struct {
+    const char *name;
+    const char *spelling;
+} TokenInfo;
+
+static const TokenInfo token_info[END_OF_TOKENS + 1] = {
+    [ADDITION] = {"ADDITION", "+"},
+    [SUBTRACTION] = {"SUBTRACTION", "-"},
+    [MULTIPLICATION] = {"MULTIPLICATION", "*"},
+    [DIVISION] = {"DIVISION", "/"},
+    [MODULO] = {"MODULO", "%"},
+    [EXPONENT] = {"EXPONENT", "^"},
+    [INT_DIVISION] = {"INT_DIVISION", "//"},
+    [ASSIGNMENT_OP] = {"ASSIGNMENT_OP", "="},
+    [INCREMENT] = {"INCREMENT", "++"},
+    [DECREMENT] = {"DECREMENT", "--"},
+    [GREATER_THAN] = {"GREATER_THAN", ">"},
+    [LESS_THAN] = {"LESS_THAN", "<"},
+    [IS_EQUAL_TO] = {"IS_EQUAL_TO", "=="},
+    [GREATER_EQUAL] = {"GREATER_EQUAL", ">="},
+    [LESS_EQUAL] = {"LESS_EQUAL", "<="},
+    [NOT_EQUAL] = {"NOT_EQUAL", "!="},
+    [AND] = {"AND", "&&"},
+    [OR] = {"OR", "||"},
+    [NOT] = {"NOT", "!"},
+    [SEMICOLON] = {"SEMICOLON", ";"},
+    [COMMA] = {"COMMA", ","},
+    [LEFT_PAREN] = {"LEFT_PAREN", "("},
+    [RIGHT_PAREN] = {"RIGHT_PAREN", ")"},
+    [LEFT_BRACKET] = {"LEFT_BRACKET", "["},
+    [RIGHT_BRACKET] = {"RIGHT_BRACKET", "]"},
+    [LEFT_BRACE] = {"LEFT_BRACE", "{"},
+    [RIGHT_BRACE] = {"RIGHT_BRACE", "}"},
+    [DBL_QUOTE] = {"DBL_QUOTE", "\""},
+    [SNGL_QUOTE] = {"SNGL_QUOTE", "'"},
+#define KEYWORD(type, spelling) [type] = {#type, spelling},
+#include "keywords.def"
+    [INTEGER] = {"INTEGER", NULL},
+    [FLOAT] = {"FLOAT", NULL},
+    [STRING] = {"STRING", NULL},
+    [COMMENT_BEGIN] = {"COMMENT_BEGIN", "<|"},
+    [COMMENT] = {"COMMENT", NULL},
+    [COMMENT_END] = {"COMMENT_END", ":>"},
+    [VAR_IDENT] = {"VAR_IDENT", NULL},
+    [FUNC_IDENT] = {"FUNC_IDENT", NULL},
+    [NOISE_WORD] = {"NOISE_WORD", "value"},
+    [INVALID] = {"INVALID", NULL},
+    [END_OF_TOKENS] = {"END_OF_TOKENS", NULL},
+};
+
+// Slot of the keyword perfect hash; empty slots have length 0
+typedef struct {
+    const char *spelling;
+    size_t length;
+    TokenType type;
+} KeywordSlot;
+
+#include "keyword_hash.h"
+
+
+// Read the whole stream into memory and lex it from the buffer, in parallel when it is large
+Token *lex(LexerState *state, FILE *file, size_t *token_count) {
+    SourceBuffer source;
+    STAT_START(started);
 
-Token *lex(FILE *file, size_t *token_count) {
-    int type;
-
-    // Initialize tokens
-    int number_of_tokens = 12; // Placeholder value for number of tokens
-    int tokens_size = 0;
-    Token *tokens = malloc(sizeof(Token) * number_of_tokens);
-    if (!tokens) {
-        perror("Failed to allocate memory for tokens");
+    fseek(file, 0, SEEK_SET);
+    if (source_read(&source, file) != 0) {
+        perror("Failed to read input file");
         exit(EXIT_FAILURE);
     }
 
-    // Find length of file
-    fseek(file, 0, SEEK_END);
-    int length = ftell(file);
-    fseek(file, 0, SEEK_SET);
+#ifdef LEX_STATS
+    uint64_t read_ticks = stats_clock() - started;
+#endif
 
-    char *lexeme = malloc(sizeof(char) * (length + 1));
-    if (!lexeme) {
-        perror("Failed to allocate memory for lexeme");
-        free(tokens);
-        exit(EXIT_FAILURE);
-    }
+    // Tokens point into the input, so the state takes the buffer itself rather than a copy of it
+    Token *tokens = lex_parallel(state, source.data, source.length, 0, token_count);
+    state->input = source;
+    STAT_ADD(state, clock[PHASE_READ], read_ticks);
+    return tokens;
+}
 
-    char ch;
+// Set up a new state for 'source'. Every field is overwritten without being released, so a state
+// that already holds buffers must go through lexer_free first, or use lexer_reset to keep them
+void lexer_init(LexerState *state, const char *source, size_t length) {
+    state->source = source;
+    state->cursor = source;
+    state->source_end = source + length;
+    state->stop = state->source_end;
+
+    state->token_start = source;
+    scan_reset(&state->scan);
+
+    state->tokens = NULL;
+    state->tokens_index = 0;
+    state->tokens_capacity = 0;
+    state->pending_index = 0;
+
+    state->lexeme_index = 0;
+
+    memset(&state->limits, 0, sizeof(state->limits));
+    state->limited = 0;
+    state->tokens_stored = 0;
+    memset(&state->error, 0, sizeof(state->error));
+
+    arena_init(&state->arena);
+    memset(&state->input, 0, sizeof(state->input));
+    symbols_init(&state->symbols);
+#ifdef LEX_STATS
+    stats_reset(&state->stats);
+#endif
+}
 
-    while ((ch = getNonBlank(file)) != EOF) {
-        lexeme[lexeme_index++] = ch; // Build lexeme by character
+// Start on another input, keeping the token array, symbols, arena blocks and limits of the last one
+// (a long-lived state, e.g. a server worker, then reaches a steady size and stops allocating)
+void lexer_reset(LexerState *state, const char *source, size_t length) {
+    Token *tokens = state->tokens;
+    size_t capacity = state->tokens_capacity;
+    Arena arena = state->arena;
+    SymbolTable symbols = state->symbols;
+    LexLimits limits = state->limits;
+
+    source_close(&state->input); // What lex() read for the last input
+    lexer_init(state, source, length);
+    lexer_limit(state, &limits);
+    state->tokens = tokens;
+    state->tokens_capacity = capacity;
+    state->arena = arena;
+    arena_reset(&state->arena);
+    state->symbols = symbols;
+    symbols_clear(&state->symbols);
+}
 
-        Token *token = malloc(sizeof(Token));
-        if (!token) {
-            perror("Failed to allocate memory for token");
-            free(tokens);
-            free(lexeme);
-            exit(EXIT_FAILURE);
-        }
-        tokens_size++;
-
-        // Expand token array if needed
-        if (tokens_size >= number_of_tokens) {
-            number_of_tokens *= 2;
-            Token *new_tokens = realloc(tokens, sizeof(Token) * number_of_tokens);
-            if (!new_tokens) {
-                perror("Failed to reallocate memory for tokens");
-                free(tokens);
-                free(lexeme);
-                exit(EXIT_FAILURE);
-            }
-            tokens = new_tokens;
+// Allocate the token array
+void lexer_start(LexerState *state) {
+    state->tokens_capacity = INITIAL_TOKENS;
+    state->tokens = malloc(sizeof(Token) * state->tokens_capacity);
+    if (!state->tokens) {
+        perror("Failed to allocate memory for tokens");
+        exit(EXIT_FAILURE);
+    }
+    STAT_ALLOC(state, sizeof(Token) * state->tokens_capacity);
+}
+
+// Terminate the token array, giving back the room when it is more than twice what was used
+// (a prediction gone wrong, or a reused state that last held a much larger input)
+Token *lexer_finish(LexerState *state, size_t *token_count) {
+    size_t needed = state->tokens_index + 1;
+    if (state->tokens_capacity > 2 * needed + INITIAL_TOKENS) {
+        Token *trimmed = realloc(state->tokens, sizeof(Token) * needed);
+        if (trimmed) {
+            state->tokens = trimmed;
+            state->tokens_capacity = needed;
         }
+    }
 
-        // Group tokens by composition
-        switch (char_class) {
-            case COMMENT_CLASS: {
-        int state = 0;
+    // Mark end of tokens (storeToken always leaves room for it)
+    state->tokens[state->tokens_index].offset = state->cursor - state->source;
+    state->tokens[state->tokens_index].length = 0;
+    state->tokens[state->tokens_index].type = END_OF_TOKENS;
+    state->tokens[state->tokens_index].integer = 0;
+    *token_count = state->tokens_index;
+    return state->tokens;
+}
 
-        // Start of block comment
-        strcpy(lexeme, "<||");
-        storeToken(token, tokens, lexeme, COMMENT_BEGIN);
+// Grow a token array so it holds 'needed' entries: doubled when one more is needed, exact for a reservation
+static int reserveTokens(Token **tokens, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return 0;
+    }
 
-        lexeme_index = 0;
+    size_t new_capacity = *capacity ? *capacity * 2 : INITIAL_TOKENS;
+    if (new_capacity < needed) {
+        new_capacity = needed;
+    }
 
-        // Process the block comment content
-        while (state != 2) {
-            ch = getNextChar(file);
+    Token *new_tokens = realloc(*tokens, sizeof(Token) * new_capacity);
+    if (!new_tokens) {
+        perror("Failed to reallocate memory for tokens");
+        exit(EXIT_FAILURE);
+    }
+    *tokens = new_tokens;
+    *capacity = new_capacity;
+    return 1;
+}
 
-            // End of file: Handle unclosed block comment
-            if (ch == EOF) {
-                lexeme[lexeme_index] = '\0';
-                storeToken(token, tokens, lexeme, COMMENT);
-                return tokens; // Exit early for EOF
-            }
+// Make room for 'count' more tokens (plus the END_OF_TOKENS marker) in one allocation
+void lexer_reserve(LexerState *state, size_t count) {
+    if (reserveTokens(&state->tokens, &state->tokens_capacity, state->tokens_index + count + 1)) {
+        STAT_ALLOC(state, sizeof(Token) * state->tokens_capacity);
+    }
+}
 
-            switch (state) {
-                case 0: // Default state
-                    if (ch == ':') {
-                        state = 1; // Potential end marker
-                    } else {
-                        lexeme[lexeme_index++] = ch;
-                    }
-                    break;
-
-                case 1: // After encountering ':'
-                    if (ch == '>') {
-                        state = 2; // Confirm end of block comment
-                    } else {
-                        lexeme[lexeme_index++] = ':';
-                        lexeme[lexeme_index++] = ch;
-                        state = 0; // Revert to default state
-                    }
-                    break;
-            }
-        }
+/* Bound the input given to lexer_init or lexer_reset (lexer_next and lexNext
+   honour it; lex_buffer and lex_parallel start from lexer_init and do not,
+   though every engine stops at a token longer than LEX_MAX_LENGTH).
+   Once a bound is broken no more tokens are stored, lexing stops as if the
+   input ended there and lexer_error says which bound and where. */
+void lexer_limit(LexerState *state, const LexLimits *limits) {
+    state->limits = *limits;
+    state->limited = limits->max_token_length || limits->max_comment_length || limits->max_tokens;
+}
 
-        // Store the block comment content
-        lexeme[lexeme_index] = '\0';
-        storeToken(token, tokens, lexeme, COMMENT);
+// The bound the input broke, NULL while it is within all of them
+const LexError *lexer_error(const LexerState *state) {
+    return state->error.code != LEX_OK ? &state->error : NULL;
+}
 
-        // Store the end marker
-        strcpy(lexeme, ":>");
-        storeToken(token, tokens, lexeme, COMMENT_END);
+const char *lex_error_message(LexErrorCode code) {
+    switch (code) {
+        case LEX_OK:
+            return "No error";
+        case LEX_TOKEN_TOO_LONG:
+            return "Token is longer than the limit";
+        case LEX_COMMENT_TOO_LONG:
+            return "Comment is longer than the limit";
+        case LEX_TOO_MANY_TOKENS:
+            return "Input has more tokens than the limit";
+    }
+    return "Unknown error";
+}
 
-        break;
+// One-line message for the bound the input broke, with the line and column of the token that broke it
+void lex_error_describe(const LexerState *state, char *buffer, size_t size) {
+    const LexError *error = lexer_error(state);
+    if (!error) {
+        snprintf(buffer, size, "%s.", lex_error_message(LEX_OK));
+        return;
     }
 
+    // The one position anybody asks for, so no lines were counted while lexing
+    LineIndex lines;
+    unsigned int line, column;
+    line_index_build(&lines, state->source, state->source_end - state->source);
+    offset_to_line_col(&lines, error->offset, &line, &column);
+    line_index_free(&lines);
 
-            case LETTER:
-                ch = getNextChar(file);
-                while (isalpha(ch) && ch != '\n') {
-                    lexeme[lexeme_index++] = ch;
-                    ch = getNextChar(file);
-                }
+    snprintf(buffer, size, "%s (%zu) at line %u, column %u.",
+             lex_error_message(error->code), error->limit, line, column);
+}
 
-                if (isdigit(ch)) {
-                    while (!isspace(ch) || ch != '\n') {
-                        lexeme[lexeme_index++] = ch;
-                        ch = getNextChar(file);
-                    }
-                    storeToken(token, tokens, lexeme, INVALID);
-                    break;
-                }
+// Check the token about to be stored against the bounds; on the first one broken, record it and stop
+static int withinLimits(LexerState *state, int type) {
+    const LexLimits *limits = &state->limits;
+    LexErrorCode code = LEX_OK;
+    size_t limit = 0;
 
-                lexeme[lexeme_index] = '\0';
-                ungetc(ch, file);
+    if (state->error.code != LEX_OK) {
+        return 0; // The second half of "returnvalue" after the first broke a bound
+    }
 
-                if (isKeyword(lexeme, ch, &type, file, tokens)) {
-                    storeToken(token, tokens, lexeme, type);
-                } else if (isReservedWord(lexeme, ch, &type, file)) {
-                    storeToken(token, tokens, lexeme, type);
-                } else {
-                    storeToken(token, tokens, lexeme, INVALID);
-                }
-                break;
+    if (state->lexeme_index > LEX_MAX_LENGTH) {
+        code = type == COMMENT ? LEX_COMMENT_TOO_LONG : LEX_TOKEN_TOO_LONG;
+        limit = LEX_MAX_LENGTH;
+    } else if (type == COMMENT) {
+        if (limits->max_comment_length && state->lexeme_index > limits->max_comment_length) {
+            code = LEX_COMMENT_TOO_LONG;
+            limit = limits->max_comment_length;
+        }
+    } else if (limits->max_token_length && state->lexeme_index > limits->max_token_length) {
+        code = LEX_TOKEN_TOO_LONG;
+        limit = limits->max_token_length;
+    }
+    if (code == LEX_OK && limits->max_tokens && state->tokens_stored >= limits->max_tokens) {
+        code = LEX_TOO_MANY_TOKENS;
+        limit = limits->max_tokens;
+    }
+    if (code == LEX_OK) {
+        return 1;
+    }
 
-            case DIGIT:
-                if (isNumLiteral(lexeme, ch, &type, file)) {
-                    storeToken(token, tokens, lexeme, type);
-                } else {
-                    storeToken(token, tokens, lexeme, INVALID);
-                }
-                break;
+    state->error.code = code;
+    state->error.limit = limit;
+    state->error.offset = state->token_start - state->source;
+    state->stop = state->source; // getNonBlank now reports the end of the input
+    state->limited = 1;          // And storeToken refuses the rest of the group
+    return 0;
+}
 
-            case OTHER:
-                if (isIdentifier(lexeme, ch, &type, file)) {
-                    storeToken(token, tokens, lexeme, type);
-                } else if (isDelimiter(lexeme, ch, &type, file)) {
-                    storeToken(token, tokens, lexeme, type);
-                } else if (isOperator(lexeme, ch, &type, file)) {
-                    storeToken(token, tokens, lexeme, type);
-                } else {
-                    storeToken(token, tokens, lexeme, INVALID);
-                }
-                break;
+// Append finished tokens to the state's array, keeping room for the END_OF_TOKENS marker.
+// Identifiers are interned again, since their symbol IDs came from another state's table.
+void lexer_append(LexerState *state, const Token *tokens, size_t count) {
+    if (reserveTokens(&state->tokens, &state->tokens_capacity, state->tokens_index + count + 1)) {
+        STAT_ALLOC(state, sizeof(Token) * state->tokens_capacity);
+    }
 
-            default:
-                strcpy(lexeme, "Unknown exception");
-                storeToken(token, tokens, lexeme, INVALID);
+    if (count > 0) {
+        Token *appended = state->tokens + state->tokens_index;
+        memcpy(appended, tokens, sizeof(Token) * count);
+        for (size_t i = 0; i < count; i++) {
+            if (appended[i].type == VAR_IDENT || appended[i].type == FUNC_IDENT) {
+                appended[i].symbol = symbols_intern(&state->symbols, state->source + appended[i].offset, appended[i].length);
+            }
         }
+        state->tokens_index += count;
+    }
+}
 
-        lexeme_index = 0;
-        (*token_count)++;
+/* Pull the next token into 'token'; 0 once the input (or state->stop) is
+   reached. Start with lexer_init. Only the tokens of one group are held at
+   a time, so memory stays constant however long the input is. */
+int lexer_next(LexerState *state, Token *token) {
+    if (!state->tokens) {
+        lexer_start(state);
     }
 
-    // Mark end of tokens
-    tokens[tokens_index].value = NULL;
-    tokens[tokens_index].type = END_OF_TOKENS;
+    while (state->pending_index == state->tokens_index) {
+        state->tokens_index = 0;
+        state->pending_index = 0;
+        if (!lexNext(state)) {
+            return 0;
+        }
+    }
 
-    free(lexeme);
-    return tokens;
+    *token = state->tokens[state->pending_index++];
+    return 1;
 }
 
+// Serial lexer: collect everything lexer_next yields into one array
+Token *lex_buffer(LexerState *state, const char *source, size_t length, size_t *token_count) {
+    Token *tokens = NULL;
+    size_t count = 0, capacity = 0;
+    Token token;
 
-int isNumLiteral(char *lexeme, char ch, int *type, FILE *file) {
-	int has_decimal = 0;
-/* no handling for strings starting with numbers
-   but ending in letters yet eg. (123sd, 422d)
-   
-   current output:
-   123 - INT
-   sd - INVALID
-*/	
-    
-    ch = getNextChar(file);
-    while(isdigit(ch) || ch == '.') {
-    	if(ch == '.' && has_decimal == 1) {
-    		while(isdigit(ch) || ch == '.') { // incorrect float format
-				lexeme[lexeme_index++] = ch;  // store any subsequent numbers and decimal points then return INVALID
-    			ch = getNextChar(file);
-			}
-			return 0;
-		} else if(ch == '.' && has_decimal == 0) {
-			has_decimal = 1;
-		}
-    	
-    	lexeme[lexeme_index++] = ch;
-    	ch = getNextChar(file);
-	}
-            
-	ungetc(ch, file);  // Put back the non-numeric character
-	column--;
-    lexeme[lexeme_index] = '\0';
-        
-    if(has_decimal) {
-    	*type = FLOAT;
-	} else {
-		*type = INTEGER;
-	}
-	
-	return 1;
-}
-
-int isIdentifier(char *lexeme, char ch, int *type, FILE *file) {
-	int state = 0;
-	
-    switch (state) {
-    	case 0: // start state
-            if (ch == '#' || ch == '~') {
-            	state = 1;
-            	ch = getNextChar(file);
-            } else {
-        		return 0; // not a variable
-            }
-        case 1: 
-            if (isalpha(ch)) {
-                state = 2; // first char is valid, move to state 2
-                lexeme[lexeme_index++] = ch;
-                ch = getNextChar(file);
-            } else {
-            	while(!(isspace(ch) || ch == '\n' || ch == '\t')) { // take entire invalid string
-            		lexeme[lexeme_index++] = ch;
-                	ch = getNextChar(file);
-            	}
-            	ungetc(ch, file);
-            	column--;
-            	*type = INVALID;
-                return 0; // invalid variable
-            }
-        case 2: // checks if next character is valid
-            while (isalpha(ch) || isdigit(ch) || ch == '_') {
-                lexeme[lexeme_index++] = ch;
-                ch = getNextChar(file);
-            }
-
-            ungetc(ch, file);
-            column--;
+    lexer_init(state, source, length);
+    reserveTokens(&tokens, &capacity, LEX_PREDICT_TOKENS(length));
+    STAT_ALLOC(state, sizeof(Token) * capacity);
 
-            *type = VAR_IDENT;
-            return 1; // valid variable identifier
-        default:
-            return 0; // Invalid variable
+    while (lexer_next(state, &token)) {
+        if (reserveTokens(&tokens, &capacity, count + 2)) { // Keep one slot free for the END_OF_TOKENS marker
+            STAT_ALLOC(state, sizeof(Token) * capacity);
+        }
+        tokens[count++] = token;
     }
-}
 
-int isKeyword(char *lexeme, char ch, int *type, FILE *file, Token *tokens) {
-	(void)ch;
-    (void)file;
-    int i = 0;  // Index for lexeme
-    ch = lexeme[i];  // Start by checking the first character
+    // Swap the iterator's buffer for the collected array
+    free(state->tokens);
+    state->tokens = tokens;
+    state->tokens_index = count;
+    state->tokens_capacity = capacity;
+    return lexer_finish(state, token_count);
+}
 
-   switch(ch) {
-    case 'b':  // Start with 'b' for the keyword 'beegin'
-        if (strlen(lexeme) == 6 &&
-            lexeme[1] == 'e' && 
-            lexeme[2] == 'e' && 
-            lexeme[3] == 'g' && 
-            lexeme[4] == 'i' && 
-            lexeme[5] == 'n') {
-            *type = BEEGIN_TOKEN;
-            return 1;  // Matched 'beegin'
-        }
-        else if (strlen(lexeme) == 7 &&
-                 lexeme[1] == 'e' && 
-                 lexeme[2] == 'e' && 
-                 lexeme[3] == 'g' && 
-                 lexeme[4] == 'o' &&
-                 lexeme[5] == 'n' &&
-                 lexeme[6] == 'e') {
-            *type = BEEGONE_TOKEN;
-            return 1; //matched 'beegone'
-        }
-        else if (strlen(lexeme) == 7 &&
-                 lexeme[1] == 'u' && 
-                 lexeme[2] == 'z' && 
-                 lexeme[3] == 'z' && 
-                 lexeme[4] == 'o' &&
-                 lexeme[5] == 'u' &&
-                 lexeme[6] == 't') {
-            *type = BUZZOUT_TOKEN;
-            return 1;  // Matched 'buzzout'
-        }
-        else if (strlen(lexeme) == 4 &&
-                 lexeme[1] == 'u' && 
-                 lexeme[2] == 'z' && 
-                 lexeme[3] == 'z') {
-            *type = BUZZ_TOKEN;
-            return 1;  // Matched 'buzz'
-        }
-        break;
-
-    case 'c':  // Start with 'c' for the keyword 'case'
-        if (strlen(lexeme) == 4 &&
-            lexeme[1] == 'a' && 
-            lexeme[2] == 's' && 
-            lexeme[3] == 'e') {
-            *type = CASE_TOKEN;
-            return 1;  // Matched 'case'
-        }
-        break;
+// Lex the token group starting at the next non-blank character; 0 once the input (or state->stop) is reached
+int lexNext(LexerState *state) {
+    int type;
+    int ch;
+#ifdef LEX_STATS
+    const char *from = state->cursor;
+#endif
+    STAT_START(started);
+
+    if ((ch = getNonBlank(state)) == EOF) {
+        STAT_ADD(state, bytes, state->cursor - from);
+        return 0;
+    }
 
-    case 'd':  // Start with 'd' for the keyword 'do' or 'downto'
-            if (lexeme[i + 1] == 'o'&&
-                lexeme[i + 2] == '\0') {
-                *type = DO_TOKEN;
-                return 1;  // Matched 'do'
+    state->lexeme_index = 1; // The lexeme is the source span from token_start
+    state->token_start = state->cursor - 1;
+
+    // Group tokens by composition
+    switch (tokenGroup(state, ch)) {
+        case COMMENT_CLASS: {
+            // Start of block comment
+            takeChar(state); // '|'
+            storeToken(state, COMMENT_BEGIN);
+
+            // Scan ahead for the end marker instead of feeding the body through getNextChar
+            const char *end = findCommentEnd(state, state->cursor);
+            const char *body_end = end ? end : state->source_end;
+
+            // The body is never copied: its token is just the span up to the end marker
+            state->token_start = state->cursor;
+            state->lexeme_index = body_end - state->cursor;
+            skipTo(state, body_end);
+
+            // Store the block comment content (runs to the end of the file when unclosed)
+            storeToken(state, COMMENT);
+
+            // Store the end marker
+            if (end) {
+                state->token_start = state->cursor;
+                state->lexeme_index = 0;
+                takeChar(state); // ':'
+                takeChar(state); // '>'
+                storeToken(state, COMMENT_END);
             }
             break;
-
-    case 'e':  // Start with 'e' for the keyword 'else' or 'elseif'
-        if (strlen(lexeme) == 6 &&
-            lexeme[1] == 'l' && 
-            lexeme[2] == 's' && 
-            lexeme[3] == 'e' &&
-            lexeme[4] == 'i' && 
-            lexeme[5] == 'f') {
-            *type = ELSEIF_TOKEN;
-            return 1;  // Matched 'elseif'
-        } 
-        else if (strlen(lexeme) == 4 &&
-                 lexeme[1] == 'l' && 
-                 lexeme[2] == 's' && 
-                 lexeme[3] == 'e') {
-            *type = ELSE_TOKEN;
-            return 1;  // Matched 'else'
-        }
-        break;
-
-    case 'f':  // Start with 'f' for the keyword 'for'
-        if (strlen(lexeme) == 3 &&
-            lexeme[1] == 'o' && 
-            lexeme[2] == 'r') {
-            *type = FOR_TOKEN;
-            return 1;  // Matched 'for'
-        }
-        break;
-
-    case 'g':  // Start with 'g' for the keyword 'gather'
-        if (strlen(lexeme) == 6 &&
-            lexeme[1] == 'a' && 
-            lexeme[2] == 't' && 
-            lexeme[3] == 'h' && 
-            lexeme[4] == 'e' && 
-            lexeme[5] == 'r') {
-            *type = GATHER_TOKEN;
-            return 1;  // Matched 'gather'
-        }
-        break;
-
-    case 'h':  // Start with 'h' for the keyword 'hive'
-        if (strlen(lexeme) == 4 &&
-            lexeme[1] == 'i' && 
-            lexeme[2] == 'v' && 
-            lexeme[3] == 'e') {
-            *type = HIVE_TOKEN;
-            return 1;  // Matched 'hive'
-       }
-        else if (strlen(lexeme) == 5 &&
-                 lexeme[1] == 'o' &&
-                 lexeme[2] == 'v' &&
-                 lexeme[3] == 'e' &&
-                 lexeme[4] == 'r') {
-            *type = HOVER_TOKEN;
-            return 1; //matched hover
         }
-        break;
 
-    case 'i':  // Start with 'i' for the keyword 'if' 
-        if (strlen(lexeme) == 2 && 
-            lexeme[1] == 'f') {
-            *type = IF_TOKEN;
-            return 1;  // Matched 'if'
-        }
-        break;
-
-    case 'q':  // Start with 'q' for the keyword 'queenbee'
-        if (strlen(lexeme) == 8 &&
-            lexeme[1] == 'u' && 
-            lexeme[2] == 'e' && 
-            lexeme[3] == 'e' && 
-            lexeme[4] == 'n' && 
-            lexeme[5] == 'b' && 
-            lexeme[6] == 'e' && 
-            lexeme[7] == 'e') {
-            *type = QUEENBEE_TOKEN;
-            return 1;  // Matched 'queenbee'
-        }
-        break;
-case 'r':  // Start with 'r' for the keyword 'return'
-    if (lexeme[i + 1] == 'e' && 
-        lexeme[i + 2] == 't' && 
-        lexeme[i + 3] == 'u' && 
-        lexeme[i + 4] == 'r' && 
-        lexeme[i + 5] == 'n') {
-        if (lexeme[i + 6] == '\0') {
-            *type = RETURN_TOKEN; 
-            return 1; // Matched 'return'
-        } else if (lexeme[i + 6] == 'v' &&
-                   lexeme[i + 7] == 'a' &&
-                   lexeme[i + 8] == 'l' &&
-                   lexeme[i + 9] == 'u' &&
-                   lexeme[i + 10] == 'e' &&
-                   lexeme[i + 11] == '\0') {
-            Token *token = malloc(sizeof(Token)); // Declare and allocate memory for token
-            if (!token) {
-                perror("Failed to allocate memory for token");
-                exit(EXIT_FAILURE);
+        case LETTER:
+            takeTo(state, scan_run(&state->scan, state->source, state->source_end, state->cursor, SCAN_ALPHA));
+
+            if (charClass(peekChar(state)) & CHAR_DIGIT) {
+                // Letters running into digits: the rest of the line is one invalid token
+                const char *newline = memchr(state->cursor, '\n', state->source_end - state->cursor);
+                takeTo(state, newline ? newline : state->source_end);
+                storeToken(state, INVALID);
+                break;
             }
 
-            strcpy(lexeme, "return"); // Replace strcpy_s with strcpy
-            lexeme_index = 6;
-            *type = RETURN_TOKEN;
-            storeToken(token, tokens, lexeme, *type);
 
-            // Prepare for "value" noise word
-            strcpy(lexeme, "value"); // Replace strcpy_s with strcpy
-            lexeme_index = 5;
+            if (isKeyword(state, ch, &type)) {
+                storeToken(state, type);
+            } else if (isNoiseWord(state, ch, &type)) {
+                storeToken(state, type);
+            } else {
+                storeToken(state, INVALID);
+            }
+            break;
 
-            token = malloc(sizeof(Token)); // Allocate memory for a new token
-            if (!token) {
-                perror("Failed to allocate memory for token");
-                exit(EXIT_FAILURE);
+        case DIGIT:
+            if (isNumLiteral(state, ch, &type)) {
+                storeToken(state, type);
+            } else {
+                storeToken(state, INVALID);
             }
+            break;
 
-            *type = NOISE_WORD;
-            storeToken(token, tokens, lexeme, *type);
-            free(token); // Free memory if no longer needed
+        case OTHER:
+            if (isIdentifier(state, ch, &type)) {
+                storeToken(state, type);
+            } else if (isDelimiter(state, ch, &type)) {
+                storeToken(state, type);
+            } else if (isOperator(state, ch, &type)) {
+                storeToken(state, type);
+            } else {
+                storeToken(state, INVALID);
+            }
+            break;
 
-            return 1;
-        }
+        default:
+            storeToken(state, INVALID); // Unknown character class
     }
-    break;
 
+    state->lexeme_index = 0;
+    STAT_ADD(state, bytes, state->cursor - from);
+    STAT_STOP(state, PHASE_CLASSIFY, started);
+    return 1;
+}
 
-    case 's':  // Start with 's' for the keyword 'size', 'sting', 'switch'
-        if (strlen(lexeme) == 5 &&
-                 lexeme[1] == 't' && 
-                 lexeme[2] == 'i' && 
-                 lexeme[3] == 'n' && 
-                 lexeme[4] == 'g') {
-            *type = STING_TOKEN;
-            return 1;  // Matched 'sting'
-        }
-        else if (strlen(lexeme) == 6 &&
-                 lexeme[1] == 'w' && 
-                 lexeme[2] == 'i' && 
-                 lexeme[3] == 't' && 
-                 lexeme[4] == 'c' && 
-                 lexeme[5] == 'h') {
-            *type = SWITCH_TOKEN;
-            return 1;  // Matched 'switch'
-        }
-        break;
-
-    case 'w':  // Start with 'w' for the keyword 'while'
-        if (strlen(lexeme) == 5 &&
-            lexeme[1] == 'h' && 
-            lexeme[2] == 'i' && 
-            lexeme[3] == 'l' && 
-            lexeme[4] == 'e') {
-            *type = WHILE_TOKEN;
-            return 1;  // Matched 'while'
-        }
-        break;
-        default:
-            return 0;
+
+// Release the tokens and anything the state copied for them in one go
+void lexer_free(LexerState *state) {
+    free(state->tokens);
+    state->tokens = NULL;
+    state->tokens_index = 0;
+    state->tokens_capacity = 0;
+    state->pending_index = 0;
+
+    arena_free(&state->arena);
+    source_close(&state->input);
+    symbols_free(&state->symbols);
 }
-return 0;
+
+// Distinct identifiers of the tokens stored so far, indexed by Token.symbol; valid until lexer_free
+const SymbolTable *lexer_symbols(const LexerState *state) {
+    return &state->symbols;
 }
 
-int isReservedWord(char *lexeme, char ch, int *type, FILE *file) {
-    (void)ch;   // To suppress unused parameter warning
-    (void)file; // To suppress unused parameter warning
+const char *token_name(TokenType type) {
+    return token_info[type].name;
+}
 
-    size_t len = strlen(lexeme); // Use size_t to avoid signed/unsigned comparison issues
+// Fixed text of a token type, or NULL when it depends on the source (literals, identifiers, comments)
+const char *token_spelling(TokenType type) {
+    return token_info[type].spelling;
+}
 
-    switch (lexeme[0]) {
-        case 'b':
-            if (len == 4 &&
-                lexeme[1] == 'o' &&
-                lexeme[2] == 'o' &&
-                lexeme[3] == 'l') {
-                *type = BOOL_TOKEN;
-                return 1; // Matched 'bool'
-            }
-            break;
+// Spelling of a token, token->length bytes long and not NUL-terminated
+const char *token_text(const char *source, const Token *token) {
+    const char *spelling = token_info[token->type].spelling;
+    return spelling ? spelling : source + token->offset;
+}
 
-        case 'c':
-            if (len == 4 &&
-                lexeme[1] == 'h' &&
-                lexeme[2] == 'a' &&
-                lexeme[3] == 'r') {
-                *type = CHAR_TOKEN;
-                return 1; // Matched 'char'
-            } else if (len == 5 &&
-                       lexeme[1] == 'h' &&
-                       lexeme[2] == 'a' &&
-                       lexeme[3] == 'i' &&
-                       lexeme[4] == 'n') {
-                *type = CHAIN_TOKEN;
-                return 1; // Matched 'chain'
-            }
-            break;
 
-        case 'i':
-            if (len == 3 &&
-                lexeme[1] == 'n' &&
-                lexeme[2] == 't') {
-                *type = INT_TOKEN;
-                return 1; // Matched 'int'
-            }
-            break;
+int isNumLiteral(LexerState *state, char ch, int *type) {
+    int has_decimal = 0;
+/* no handling for strings starting with numbers
+   but ending in letters yet eg. (123sd, 422d)
 
-        case 'f':
-            if (len == 5 &&
-                lexeme[1] == 'l' &&
-                lexeme[2] == 'o' &&
-                lexeme[3] == 'a' &&
-                lexeme[4] == 't') {
-                *type = FLOAT_TOKEN;
-                return 1; // Matched 'float'
-            } else if (len == 5 &&
-                       lexeme[1] == 'a' &&
-                       lexeme[2] == 'l' &&
-                       lexeme[3] == 's' &&
-                       lexeme[4] == 'e') {
-                *type = FALSE_TOKEN;
-                return 1; // Matched 'false'
-            }
+   current output:
+   123 - INT
+   sd - INVALID
+*/
+
+    for (;;) {
+        takeTo(state, scan_run(&state->scan, state->source, state->source_end, state->cursor, SCAN_DIGIT));
+        if (peekChar(state) != '.') {
             break;
+        }
 
-        case 't':
-            if (len == 4 &&
-                lexeme[1] == 'r' &&
-                lexeme[2] == 'u' &&
-                lexeme[3] == 'e') {
-                *type = TRUE_TOKEN;
-                return 1; // Matched 'true'
+        if (has_decimal == 1) {
+            while ((charClass(ch = peekChar(state)) & CHAR_DIGIT) || ch == '.') { // incorrect float format
+                takeChar(state);     // store any subsequent numbers and decimal points then return INVALID
             }
-            break;
+            return 0;
+        }
 
-        default:
-            break; // Not a reserved word
+        has_decimal = 1;
+        takeChar(state);
     }
 
-    return 0; // Not a reserved word
-}
 
-int isNoiseWord(char *lexeme, char ch, int *type, FILE *file) {
-    (void)ch;   // Suppress unused parameter warning
-    (void)file; // Suppress unused parameter warning
-    (void)type; // Suppress unused parameter warning
+    if (has_decimal) {
+        *type = FLOAT;
+    } else {
+        *type = INTEGER;
+    }
+
+    return 1;
+}
 
-    size_t len = strlen(lexeme); // Use size_t to avoid signed/unsigned warnings
+int isIdentifier(LexerState *state, char ch, int *type) {
+    const char *lexeme = state->token_start;
+    int id_state = 0;
 
-    switch (lexeme[0]) { // Check the first character of lexeme
-        case 'r': // Check for 'returnvalue'
-            if (len == 11 &&
-                lexeme[1] == 'e' &&
-                lexeme[2] == 't' &&
-                lexeme[3] == 'u' &&
-                lexeme[4] == 'r' &&
-                lexeme[5] == 'n' &&
-                lexeme[6] == 'v' &&
-                lexeme[7] == 'a' &&
-                lexeme[8] == 'l' &&
-                lexeme[9] == 'u' &&
-                lexeme[10] == 'e') {
-                return 1; // Matched 'returnvalue'
+    switch (id_state) {
+        case 0: // start state
+            if (ch == '#' || ch == '~') {
+                id_state = 1;
+            } else {
+                return 0; // not a variable
             }
-            break;
+            // fall through
+        case 1:
+            if (charClass(peekChar(state)) & CHAR_IDENT_START) {
+                id_state = 2; // first char is valid, move to state 2
+                takeChar(state);
+            } else {
+                int next; // Not 'ch': a 0xFF byte stored in a char reads back as EOF
+                while ((next = peekChar(state)) != EOF && !(charClass(next) & CHAR_SPACE)) { // take entire invalid string
+                    takeChar(state);
+                }
+                *type = INVALID;
+                return 0; // invalid variable
+            }
+            // fall through
+        case 2: // checks if next character is valid
+            takeTo(state, scan_run(&state->scan, state->source, state->source_end, state->cursor, SCAN_WORD));
 
+            *type = lexeme[0] == '~' ? FUNC_IDENT : VAR_IDENT;
+            return 1; // valid identifier
         default:
-            break; // Not a noise word
+            return 0; // Invalid variable
+    }
+}
+
+// Keywords and reserved words: one probe of the generated perfect hash, then one compare
+int isKeyword(LexerState *state, char ch, int *type) {
+    const char *lexeme = state->token_start;
+    size_t length = state->lexeme_index;
+    (void)ch;
+
+    const KeywordSlot *slot = &keyword_hash[KEYWORD_HASH((unsigned char)lexeme[0],
+                                                         (unsigned char)lexeme[length - 1], length)];
+    STAT_ADD(state, keyword_lookups, 1);
+    if (slot->length == length && memcmp(slot->spelling, lexeme, length) == 0) {
+        STAT_ADD(state, keyword_hits, 1);
+        *type = slot->type;
+        return 1;
+    }
+
+    return 0;
+}
+
+// "returnvalue" is stored as the keyword "return" followed by the noise word "value"
+int isNoiseWord(LexerState *state, char ch, int *type) {
+    const char *lexeme = state->token_start;
+    (void)ch;
+
+    if (state->lexeme_index != 11 || memcmp(lexeme, "returnvalue", 11) != 0) {
+        return 0; // Not a noise word
     }
 
-    return 0; // Not a noise word
+    state->lexeme_index = 6;
+    storeToken(state, RETURN_TOKEN);
+
+    state->token_start += 6;
+    state->lexeme_index = 5;
+    *type = NOISE_WORD;
+
+    return 1;
 }
 
 
-int isDelimiter(char *lexeme, char ch, int *type, FILE *file) {
-    (void)lexeme; // Suppress unused parameter warning
-    (void)file;   // Suppress unused parameter warning
+int isDelimiter(LexerState *state, char ch, int *type) {
+    (void)state; // Suppress unused parameter warning
 
     switch (ch) {
         case ';':
@@ -663,144 +652,91 @@ int isDelimiter(char *lexeme, char ch, int *type, FILE *file) {
 }
 
 
-int isOperator(char *lexeme, char ch, int *type, FILE *file) {
+int isOperator(LexerState *state, char ch, int *type) {
     switch (ch) {
-        case '+':    
+        case '+':
             *type = ADDITION;
-            ch = getc(file);
-            if (ch == '+') {
+            if (peekChar(state) == '+') {
                 *type = INCREMENT;
-                lexeme[lexeme_index++] = ch;
-                lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
-                return 1;
-            } else {
-                ungetc(ch, file);
+                takeChar(state);
             }
-            lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
             return 1;
 
         case '-':
             *type = SUBTRACTION;
-            ch = getc(file);
-            if (ch == '-') {
+            if (peekChar(state) == '-') {
                 *type = DECREMENT;
-                lexeme[lexeme_index++] = ch;
-                lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
-                return 1;
-            } else {
-                ungetc(ch, file);
+                takeChar(state);
             }
-            lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
             return 1;
 
         case '*':
             *type = MULTIPLICATION;
-            lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
             return 1;
 
         case '/':
-            ch = getNextChar(file);
-            if (ch == '/') {
-                lexeme[lexeme_index++] = ch;
+            *type = DIVISION;
+            if (peekChar(state) == '/') {
                 *type = INT_DIVISION;
-                lexeme[lexeme_index] ='\0';
-                return 1;
-            } else {
-                ungetc(ch,file);
-                *type = DIVISION;
-                lexeme[lexeme_index] = '\0';
-                return 1;
+                takeChar(state);
             }
+            return 1;
 
         case '%':
             *type = MODULO;
-            lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
             return 1;
 
         case '^':
             *type = EXPONENT;
-            lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
             return 1;
 
         case '>':
-            ch = getNextChar(file);
-            if (ch == '=') {
-                lexeme[lexeme_index++] = ch;
+            *type = GREATER_THAN;
+            if (peekChar(state) == '=') {
                 *type = GREATER_EQUAL;
-                lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
-                return 1;
-            } else {
-                ungetc(ch, file);
-                *type = GREATER_THAN;
-                lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
-                return 1;
+                takeChar(state);
             }
+            return 1;
 
         case '<':
-            ch = getNextChar(file);
-            if (ch == '=') {
-                lexeme[lexeme_index++] = ch;
+            *type = LESS_THAN;
+            if (peekChar(state) == '=') {
                 *type = LESS_EQUAL;
-                lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
-                return 1;
-            } else {
-                ungetc(ch, file);
-                *type = LESS_THAN;
-                lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
-                return 1;
+                takeChar(state);
             }
+            return 1;
 
         case '=':
-            ch = getNextChar(file);
-            if (ch == '=') {
-                lexeme[lexeme_index++] = ch;
+            *type = ASSIGNMENT_OP;
+            if (peekChar(state) == '=') {
                 *type = IS_EQUAL_TO;
-                lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
-                return 1;
-            } else {
-                ungetc(ch, file);
-                *type = ASSIGNMENT_OP;
-                lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
-                return 1;
+                takeChar(state);
             }
+            return 1;
 
         case '&':
-            ch = getNextChar(file);
-            if (ch == '&') {
-                lexeme[lexeme_index++] = ch;
+            if (peekChar(state) == '&') {
                 *type = AND;
-                lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
+                takeChar(state);
                 return 1;
-            } else {
-                ungetc(ch, file);
-                return 0; // Not a valid operator
             }
+            return 0; // Not a valid operator
 
         case '|':
-            ch = getNextChar(file);
-            if (ch == '|') {
-                lexeme[lexeme_index++] = ch;
+            if (peekChar(state) == '|') {
                 *type = OR;
-                lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
+                takeChar(state);
                 return 1;
-            } else {
-                ungetc(ch, file);
-                return 0; // Not a valid operator
             }
+            return 0; // Not a valid operator
 
         case '!':
-            ch = getNextChar(file);
-            if (ch == '=') {
-                lexeme[lexeme_index++] = ch;
+            *type = NOT;
+            if (peekChar(state) == '=') {
                 *type = NOT_EQUAL;
-                lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
-                return 1;
-            } else {
-                ungetc(ch, file);
-                *type = NOT;
-                lexeme[lexeme_index] = '\0'; // Null-terminate lexeme
-                return 1;
+                takeChar(state);
             }
+            return 1;
 
         default:
             return 0; // Not an operator
@@ -809,61 +745,140 @@ int isOperator(char *lexeme, char ch, int *type, FILE *file) {
 
 
 
-// return any character including spaces or newlines
-char getNextChar(FILE *file) {
-	char ch = fgetc(file), temp;
-	column++;
-	
-	// seperate characters by class
-	if(ch == '<') {
-		temp = getc(file);
-        if(temp == '|') {
-            char_class = COMMENT_CLASS;
-            ungetc(temp, file);
-        } else {
-            ungetc(temp, file);
-        }
-	} else if(isalpha(ch)) {
-		char_class = LETTER;
-	} else if(isdigit(ch)) {
-		char_class = DIGIT;
-	} else {
-		char_class = OTHER;
-	} 
 
-	return ch;
+
+// return any character including spaces or newlines, EOF at the end of the buffer
+int getNextChar(LexerState *state) {
+    if (state->cursor >= state->source_end) {
+        return EOF;
+    }
+
+    return (unsigned char)*state->cursor++;
 }
 
-// skip whitespaces and newline
-char getNonBlank(FILE *file) {
-    char ch = getNextChar(file); // Correct function name capitalization
+// seperate the first character of a token group by class; '<' just read followed by '|' opens a comment
+int tokenGroup(LexerState *state, int ch) {
+    int cls = charClass(ch);
 
-    while (isspace(ch) || ch == '\t' || ch == '\n') {
-        if (ch == '\n') {
-            line++;   // Increment line number
-            column = 0; // Reset column number
-        }
-        ch = getNextChar(file); // Get the next character
+    if (ch == '<' && peekChar(state) == '|') {
+        return COMMENT_CLASS;
+    } else if (cls & CHAR_IDENT_START) {
+        return LETTER;
+    } else if (cls & CHAR_DIGIT) {
+        return DIGIT;
     }
+    return OTHER;
+}
 
-    return ch; // Return the first non-blank character
+// look at the next character without consuming it
+int peekChar(LexerState *state) {
+    STAT_ADD(state, lookaheads, 1);
+    return state->cursor < state->source_end ? (unsigned char)*state->cursor : EOF;
 }
 
-void storeToken(Token *token, Token *tokens, char *lexeme, int type) {
-    token->value = malloc(strlen(lexeme) + 1);
-    lexeme[lexeme_index] = '\0';
-    strcpy(token->value, lexeme);
-    token->line = line;
-    token->column = column;
-    token->type = type;
+// skip whitespaces and newline without consuming the character after them
+void skipBlanks(LexerState *state) {
+    skipTo(state, scan_run(&state->scan, state->source, state->source_end, state->cursor, SCAN_SPACE));
+}
+
+// skip whitespaces and newline, EOF at the end of the input or once state->stop is reached
+int getNonBlank(LexerState *state) {
+    skipBlanks(state);
+
+    if (state->cursor >= state->stop) {
+        return EOF; // Tokens from here on belong to whoever lexes past stop
+    }
+
+    return getNextChar(state); // Return the first non-blank character
+}
+
+// consume everything up to 'to' (positions are offsets, so there is nothing else to keep current)
+void skipTo(LexerState *state, const char *to) {
+    state->cursor = to;
+}
+
+// consume the next character as part of the lexeme
+void takeChar(LexerState *state) {
+    getNextChar(state);
+    state->lexeme_index++;
+}
 
-    tokens[tokens_index] = *token;
-    tokens_index++;
+// consume everything up to 'to' as part of the lexeme
+void takeTo(LexerState *state, const char *to) {
+    size_t length = to - state->cursor;
 
-    // Debugging statement
-    printf("DEBUG: Stored token -> LINE: %u, COLUMN: %u, LEXEME: '%s', TYPE: %d\n", 
-       token->line, token->column, token->value ? token->value : "(null)", token->type);
+    state->lexeme_index += length;
+    skipTo(state, to);
+}
+
+// locate the ':>' that closes the comment starting at 'from', NULL if it is never closed
+const char *findCommentEnd(LexerState *state, const char *from) {
+    const char *colon;
+
+    while ((colon = memchr(from, ':', state->source_end - from)) != NULL) {
+        if (colon + 1 < state->source_end && colon[1] == '>') {
+            return colon;
+        }
+        from = colon + 1;
+    }
 
+    return NULL;
 }
 
+// append a token spanning the current lexeme, growing the array as needed
+void storeToken(LexerState *state, int type) {
+    STAT_START(started);
+
+    if ((state->limited || state->lexeme_index > LEX_MAX_LENGTH) && !withinLimits(state, type)) {
+        return;
+    }
+
+    // Keep one slot free for the END_OF_TOKENS marker
+    if (reserveTokens(&state->tokens, &state->tokens_capacity, state->tokens_index + 2)) {
+        STAT_ALLOC(state, sizeof(Token) * state->tokens_capacity);
+    }
+
+    Token *token = &state->tokens[state->tokens_index];
+    token->offset = state->token_start - state->source;
+    token->length = (unsigned int)state->lexeme_index;
+    token->integer = 0;
+    switch (type) {
+        case VAR_IDENT:
+        case FUNC_IDENT:
+            token->symbol = symbols_intern(&state->symbols, state->token_start, token->length);
+            break;
+
+        // Literals too large to represent are invalid
+        case INTEGER:
+            if (literal_integer(state->token_start, token->length, &token->integer) != 0) {
+                token->integer = 0;
+                type = INVALID;
+            }
+            break;
+
+        case FLOAT:
+            if (literal_float(state->token_start, token->length, &token->real) != 0) {
+                token->integer = 0;
+                type = INVALID;
+            }
+            break;
+
+        default:
+            break;
+    }
+    token->type = type;
+    state->tokens_index++;
+    state->tokens_stored++;
 
+    STAT_ADD(state, tokens[type], 1);
+    if (type == INVALID) {
+        STAT_ADD(state, invalid_bytes, token->length);
+    }
+    STAT_STOP(state, PHASE_STORE, started);
+
+#ifdef LEX_DEBUG
+    // Debugging statement (build with -DLEX_DEBUG)
+    printf("DEBUG: Stored token -> OFFSET: %zu, LEXEME: '%.*s', TYPE: %d\n",
+       token->offset, (int)token->length, token_text(state->source, token), token->type);
+#endif
+}
@@ -2,11 +2,18 @@
 #define LEX_H
 
 #include <stdio.h>
+#include <limits.h>
+
+#include "arena.h"
+#include "scan.h"
+#include "source.h"
+#include "symbols.h"
 
 typedef enum {
     // arithmetic operators
     ADDITION, SUBTRACTION, MULTIPLICATION, DIVISION, 
     MODULO, EXPONENT, INT_DIVISION, ASSIGNMENT_OP,
+    INCREMENT, DECREMENT,
     
     // relational operators
     GREATER_THAN, LESS_THAN, IS_EQUAL_TO,
@@ -19,19 +26,14 @@ typedef enum {
     SEMICOLON, COMMA, LEFT_PAREN, RIGHT_PAREN, LEFT_BRACKET,
     RIGHT_BRACKET, LEFT_BRACE, RIGHT_BRACE, DBL_QUOTE, SNGL_QUOTE,
     
-    // keywords
-    BUZZ_TOKEN, BEEGIN_TOKEN, QUEENBEE_TOKEN, BEEGONE_TOKEN, FOR_TOKEN, THIS_TOKEN, 
-    IS_TOKEN, WHILE_TOKEN, DO_TOKEN, UPTO_TOKEN, DOWNTO_TOKEN, HIVE_TOKEN, 
-    SIZE_TOKEN, STING_TOKEN, IF_TOKEN, RETURNS_TOKEN, ELSEIF_TOKEN, ELSE_TOKEN, 
-    HOVER_TOKEN, GATHER_TOKEN, BUZZOUT_TOKEN, SWITCH_TOKEN, CASE_TOKEN, 
-
-    // reserved words
-    CHAR_TOKEN, CHAIN_TOKEN, INT_TOKEN, FLOAT_TOKEN, BOOL_TOKEN, TRUE_TOKEN, FALSE_TOKEN, 
+    // keywords and reserved words
+#define KEYWORD(type, spelling) type,
+#include "keywords.def"
 
     // literals
     INTEGER, FLOAT, STRING,
     
-    COMMENT,
+    COMMENT_BEGIN, COMMENT, COMMENT_END,
     VAR_IDENT,
     FUNC_IDENT,
     NOISE_WORD,
@@ -39,25 +41,130 @@ typedef enum {
     END_OF_TOKENS
 } TokenType;
 
+#include "stats.h"
+
+// A token refers back into the source buffer, which has to outlive it; its line and
+// column are worked out from the offset when needed (see lines.h)
 typedef struct {
     TokenType type;
-    char *value;
-    unsigned int line;    // Line number
-    unsigned int column;  // Column number
+    unsigned int length;  // Length of the spelling in bytes
+    size_t offset;        // Byte offset of the first character in the source
+    union {               // Decoded when the token is stored; 0 for other types
+        uint32_t symbol;  // VAR_IDENT, FUNC_IDENT only: dense ID of the spelling (see lexer_symbols);
+                          // other tokens read 0 here, which is a valid ID, so check the type first
+        uint64_t integer; // INTEGER
+        double real;      // FLOAT
+    };
 } Token;
 
 
+// Source bytes per token, measured on the samples and generated corpora: 6-8 for code, more
+// where comments are long. Low on purpose: pages of an overestimate are never touched, and
+// lexer_finish trims the array, while an underestimate costs a copy of everything so far.
+#define LEX_BYTES_PER_TOKEN 6
+
+// Tokens to reserve for 'length' source bytes so most inputs need one allocation
+#define LEX_PREDICT_TOKENS(length) ((length) / LEX_BYTES_PER_TOKEN + 16)
+
+// Longest span Token.length holds: a longer token or comment body breaks LEX_TOKEN_TOO_LONG or
+// LEX_COMMENT_TOO_LONG with this limit, with or without lexer_limit, so no length ever wraps
+#ifndef LEX_MAX_LENGTH
+#define LEX_MAX_LENGTH UINT_MAX
+#endif
+
+// Bounds for untrusted input, applied with lexer_limit; 0 leaves a bound off
+typedef struct {
+    size_t max_token_length;    // Bytes in any token but a comment body
+    size_t max_comment_length;  // Bytes in the body of one <| ... :> comment
+    size_t max_tokens;          // Tokens stored for the whole input
+} LexLimits;
+
+typedef enum {
+    LEX_OK,
+    LEX_TOKEN_TOO_LONG,
+    LEX_COMMENT_TOO_LONG,
+    LEX_TOO_MANY_TOKENS
+} LexErrorCode;
+
+// The bound an input broke, at the token that broke it; lexing stops there
+typedef struct {
+    LexErrorCode code;
+    size_t limit;             // The bound, in bytes or tokens
+    size_t offset;            // Start of the offending token (offset_to_line_col gives its line)
+} LexError;
+
+// Everything one lexing run needs; one state per thread lets several files be lexed at once
+typedef struct {
+    // Input buffer
+    const char *source;       // First byte of the input
+    const char *cursor;       // Next unread byte
+    const char *source_end;   // One past the last byte
+    const char *stop;         // No new token starts at or after this point
+
+    // Scanning
+    const char *token_start;  // First character of the current token
+    ScanCache scan;           // Character class bitmaps of the block around the cursor
+
+    // Output
+    Token *tokens;
+    size_t tokens_index;      // Number of tokens stored so far
+    size_t tokens_capacity;
+    size_t pending_index;     // Next stored token lexer_next hands out
+    Arena arena;              // Names kept past their input (see symbols_keep_names), released by lexer_free
+    SourceBuffer input;       // Stream read by lex(), which the tokens point into; closed by lexer_free
+    SymbolTable symbols;      // Every distinct identifier stored so far
+
+    // Lexeme under construction: lexeme_index characters from token_start
+    size_t lexeme_index;
+
+    // Bounds (see lexer_limit)
+    LexLimits limits;
+    int limited;              // Some bound is set, so storeToken checks every token
+    size_t tokens_stored;     // Tokens stored since lexer_init, counted against limits.max_tokens
+    LexError error;
+
+#ifdef LEX_STATS
+    LexStats stats;           // Counters for --stats (build with -DLEX_STATS)
+#endif
+} LexerState;
+
+
 // Function Prototypes
-Token* lex(FILE *file, size_t *token_count);
-int isNumLiteral(char *lexeme, char ch, int *type, FILE *file);
-int isKeyword(char *lexeme, char ch, int *type, FILE *file, Token *tokens);
-int isReservedWord(char *lexeme, char ch, int *type, FILE *file);
-int isNoiseWord(char *lexeme, char ch, int *type, FILE *file);
-int isIdentifier(char *lexeme, char ch, int *type, FILE *file);
-int isDelimiter(char *lexeme, char ch, int *type, FILE *file);
-int isOperator(char *lexeme, char ch, int *type, FILE *file);
-char getNextChar(FILE *file);
-char getNonBlank(FILE *file);
-void storeToken(Token *token, Token *tokens, char *lexeme, int type);
+Token* lex(LexerState *state, FILE *file, size_t *token_count);
+Token* lex_buffer(LexerState *state, const char *source, size_t length, size_t *token_count);
+Token* lex_parallel(LexerState *state, const char *source, size_t length, int workers, size_t *token_count);
+void lexer_init(LexerState *state, const char *source, size_t length);
+void lexer_reset(LexerState *state, const char *source, size_t length);
+void lexer_start(LexerState *state);
+void lexer_reserve(LexerState *state, size_t count);
+void lexer_limit(LexerState *state, const LexLimits *limits);
+const LexError *lexer_error(const LexerState *state);
+const char *lex_error_message(LexErrorCode code);
+void lex_error_describe(const LexerState *state, char *buffer, size_t size);
+Token* lexer_finish(LexerState *state, size_t *token_count);
+void lexer_append(LexerState *state, const Token *tokens, size_t count);
+int lexer_next(LexerState *state, Token *token);
+int lexNext(LexerState *state);
+void lexer_free(LexerState *state);
+const SymbolTable *lexer_symbols(const LexerState *state);
+const char *token_name(TokenType type);
+const char *token_spelling(TokenType type);
+const char *token_text(const char *source, const Token *token);
+int isNumLiteral(LexerState *state, char ch, int *type);
+int isKeyword(LexerState *state, char ch, int *type);
+int isNoiseWord(LexerState *state, char ch, int *type);
+int isIdentifier(LexerState *state, char ch, int *type);
+int isDelimiter(LexerState *state, char ch, int *type);
+int isOperator(LexerState *state, char ch, int *type);
+int getNextChar(LexerState *state);
+int tokenGroup(LexerState *state, int ch);
+int peekChar(LexerState *state);
+void skipBlanks(LexerState *state);
+int getNonBlank(LexerState *state);
+void skipTo(LexerState *state, const char *to);
+void takeChar(LexerState *state);
+void takeTo(LexerState *state, const char *to);
+const char *findCommentEnd(LexerState *state, const char *from);
+void storeToken(LexerState *state, int type);
 
 #endif
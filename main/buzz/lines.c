@@ -0,0 +1,126 @@
+#include "lines.h"
+#include "scan.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#define LINE_BLOCK 64
+#define BYTES_PER_LINE 32   // First guess at the table size; it doubles when the guess is short
+
+// Bit i set when byte i of the 64-byte block is a newline
+static uint64_t newline_bits(const char *block) {
+#if defined(__AVX2__)
+    __m256i newline = _mm256_set1_epi8('\n');
+    uint64_t low = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)block), newline));
+    uint64_t high = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(block + 32)), newline));
+    return low | high << 32;
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128i newline = _mm_set1_epi8('\n');
+    uint64_t bits = 0;
+    for (int i = 0; i < LINE_BLOCK; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + i));
+        bits |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)) << i;
+    }
+    return bits;
+#else
+    uint64_t bits = 0;
+    for (int i = 0; i < LINE_BLOCK; i++) {
+        bits |= (uint64_t)(block[i] == '\n') << i;
+    }
+    return bits;
+#endif
+}
+
+static void add_line(LineIndex *index, size_t start) {
+    if (index->count == index->capacity) {
+        size_t capacity = index->capacity * 2;
+        size_t *starts = realloc(index->starts, sizeof(size_t) * capacity);
+        if (!starts) {
+            perror("Failed to allocate memory for line index");
+            exit(EXIT_FAILURE);
+        }
+        index->starts = starts;
+        index->capacity = capacity;
+    }
+    index->starts[index->count++] = start;
+}
+
+// Record where every line of 'source' starts, 64 bytes per step; release with line_index_free
+void line_index_build(LineIndex *index, const char *source, size_t length) {
+    index->capacity = length / BYTES_PER_LINE + 16;
+    index->starts = malloc(sizeof(size_t) * index->capacity);
+    if (!index->starts) {
+        perror("Failed to allocate memory for line index");
+        exit(EXIT_FAILURE);
+    }
+    index->starts[0] = 0;
+    index->count = 1;
+
+    size_t i = 0;
+    for (; i + LINE_BLOCK <= length; i += LINE_BLOCK) {
+        for (uint64_t bits = newline_bits(source + i); bits; bits &= bits - 1) {
+            add_line(index, i + count_trailing_zeros(bits) + 1);
+        }
+    }
+    for (; i < length; i++) {
+        if (source[i] == '\n') {
+            add_line(index, i + 1);
+        }
+    }
+}
+
+// Line and column of the byte at 'offset', by binary search of the line starts
+void offset_to_line_col(const LineIndex *index, size_t offset, unsigned int *line, unsigned int *column) {
+    size_t low = 0, high = index->count;
+
+    // Last line starting at or before offset
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (index->starts[mid] <= offset) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    *line = (unsigned int)(low + 1);
+    *column = (unsigned int)(offset - index->starts[low] + 1);
+}
+
+void line_index_free(LineIndex *index) {
+    free(index->starts);
+    index->starts = NULL;
+    index->count = 0;
+    index->capacity = 0;
+}
+
+void line_cursor_init(LineCursor *cursor, const char *source) {
+    cursor->source = source;
+    cursor->counted = source;
+    cursor->line_start = source;
+    cursor->line = 1;
+}
+
+// Line and column of 'offset', which is not before the last offset asked for
+void line_cursor_seek(LineCursor *cursor, size_t offset, unsigned int *line, unsigned int *column) {
+    const char *at = cursor->source + offset;
+    const char *newline;
+
+    if (at > cursor->counted) {
+        while ((newline = memchr(cursor->counted, '\n', at - cursor->counted)) != NULL) {
+            cursor->line++;
+            cursor->line_start = newline + 1;
+            cursor->counted = newline + 1;
+        }
+        cursor->counted = at;
+    }
+
+    *line = cursor->line;
+    *column = (unsigned int)(at - cursor->line_start + 1);
+}
@@ -0,0 +1,31 @@
+#ifndef LINES_H
+#define LINES_H
+
+#include <stddef.h>
+
+/* Tokens only carry byte offsets. Lines and columns (both counted from 1,
+   a column being one byte) are worked out when something asks for them. */
+
+// Where every line of a source starts, for positions asked for in any order
+typedef struct {
+    size_t *starts;     // starts[i]: offset of the first byte of line i + 1
+    size_t count;       // Lines; a source without newlines has one
+    size_t capacity;
+} LineIndex;
+
+// Positions of offsets visited in increasing order, found by walking forward from the last one
+typedef struct {
+    const char *source;
+    const char *counted;    // Newlines before here are counted in 'line'
+    const char *line_start;
+    unsigned int line;
+} LineCursor;
+
+// Function Prototypes
+void line_index_build(LineIndex *index, const char *source, size_t length);
+void offset_to_line_col(const LineIndex *index, size_t offset, unsigned int *line, unsigned int *column);
+void line_index_free(LineIndex *index);
+void line_cursor_init(LineCursor *cursor, const char *source);
+void line_cursor_seek(LineCursor *cursor, size_t offset, unsigned int *line, unsigned int *column);
+
+#endif
@@ -0,0 +1,118 @@
+#include "literal.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define FLOAT_EXACT_DIGITS 22        // 10^22 is the largest power of ten a double holds exactly
+#define FLOAT_EXACT_MANTISSA (1ULL << 53)
+#define FLOAT_COPY 64                // Longer literals are copied to the heap for strtod
+
+static const double powers_of_ten[FLOAT_EXACT_DIGITS + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Value of eight ASCII digits: pairs, then quads, then both halves combined in three multiplies
+static uint32_t eight_digits(const char *digits) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t chunk;
+    memcpy(&chunk, digits, sizeof(chunk));
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFULL;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFULL;
+    chunk = (chunk * 10000 + (chunk >> 32)) & 0xFFFFFFFFULL;
+    return (uint32_t)chunk;
+#else
+    uint32_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = value * 10 + (uint32_t)(digits[i] - '0');
+    }
+    return value;
+#endif
+}
+
+// Digits to a value, eight at a time; at most 19 digits, so it cannot overflow
+static uint64_t digits_value(const char *digits, size_t length) {
+    uint64_t value = 0;
+
+    for (; length >= 8; digits += 8, length -= 8) {
+        value = value * 100000000 + eight_digits(digits);
+    }
+    for (; length > 0; digits++, length--) {
+        value = value * 10 + (uint64_t)(*digits - '0');
+    }
+    return value;
+}
+
+// Decode an INTEGER spelling (only digits); -1 when it does not fit 64 bits
+int literal_integer(const char *digits, size_t length, uint64_t *value) {
+    while (length > 1 && *digits == '0') {
+        digits++, length--;
+    }
+
+    if (length <= 19) {
+        *value = digits_value(digits, length);
+        return 0;
+    }
+    if (length > 20) {
+        return -1;
+    }
+
+    // Twenty digits: the last one may push it past UINT64_MAX
+    uint64_t high = digits_value(digits, 19);
+    unsigned int last = (unsigned int)(digits[19] - '0');
+    if (high > (UINT64_MAX - last) / 10) {
+        return -1;
+    }
+    *value = high * 10 + last;
+    return 0;
+}
+
+// Decode a FLOAT spelling (digits, '.', digits); -1 when it is too large for a double
+int literal_float(const char *text, size_t length, double *value) {
+    const char *dot = memchr(text, '.', length);
+    size_t whole = dot ? (size_t)(dot - text) : length;
+    size_t fraction = dot ? length - whole - 1 : 0;
+    const char *fraction_digits = text + whole + 1;
+
+    // Zeros that do not change the value: leading ones of the whole part, trailing ones of the fraction
+    while (whole > 0 && *text == '0') {
+        text++, whole--;
+    }
+    while (fraction > 0 && fraction_digits[fraction - 1] == '0') {
+        fraction--;
+    }
+
+    // Exact fast path (Clinger): an exact mantissa divided by an exact power of ten rounds once
+    if (whole + fraction <= 19 && fraction <= FLOAT_EXACT_DIGITS) {
+        uint64_t mantissa = digits_value(text, whole);
+        for (size_t i = 0; i < fraction; i++) {
+            mantissa = mantissa * 10 + (uint64_t)(fraction_digits[i] - '0');
+        }
+        if (mantissa <= FLOAT_EXACT_MANTISSA) {
+            *value = (double)mantissa / powers_of_ten[fraction];
+            return 0;
+        }
+    }
+
+    // Everything else is rounded by the C library, from a terminated copy
+    size_t copy_length = whole + 1 + fraction;
+    char buffer[FLOAT_COPY];
+    char *copy = copy_length < FLOAT_COPY ? buffer : malloc(copy_length + 1);
+    if (!copy) {
+        perror("Failed to allocate memory for float literal");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, text, whole);
+    copy[whole] = '.';
+    memcpy(copy + whole + 1, fraction_digits, fraction);
+    copy[copy_length] = '\0';
+
+    *value = strtod(copy, NULL);
+    if (copy != buffer) {
+        free(copy);
+    }
+    return isinf(*value) ? -1 : 0;
+}
@@ -0,0 +1,11 @@
+#ifndef LITERAL_H
+#define LITERAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Function Prototypes
+int literal_integer(const char *digits, size_t length, uint64_t *value);
+int literal_float(const char *text, size_t length, double *value);
+
+#endif
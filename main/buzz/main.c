@@ -4,110 +4,225 @@
 #include <ctype.h>
 
 #include "lex.h"
+#include "source.h"
+#include "output.h"
+#include "batch.h"
+#include "parallel.h"
+#include "tokenfile.h"
+#include "cache.h"
+#include "server.h"
 
 const char* VALID_EXTENSION = ".bz";
 
 // Function to check if the file extension is correct
 void check_file_type(const char* filename, const char* expectedExtension);
 
+// Function to lex many files on a thread pool
+int run_batch(int argc, char *argv[]);
+
+// Function to serve lex requests on a local socket
+int run_server(int argc, char *argv[]);
+
+// Function to print the command line syntax
+void print_usage(const char *program);
+
 int main(int argc, char *argv[]) {
+    // Batch mode: many inputs into one output directory
+    if (argc >= 2 && strcmp(argv[1], "--batch") == 0) {
+        return run_batch(argc, argv);
+    }
+
+    // Server mode: stay resident and lex what clients send
+    if (argc >= 2 && strcmp(argv[1], "--serve") == 0) {
+        return run_server(argc, argv);
+    }
+
+    // Options: output format and where the tokens go
+    OutputFormat format = OUTPUT_TABLE;
+    int to_file = 1, to_stdout = 1;
+    const char *cache_dir = NULL;
+    size_t cache_limit = TOKEN_CACHE_LIMIT;
+    int show_stats = 0;
+    int arg = 1;
+
+    while (arg + 1 < argc && strncmp(argv[arg], "--", 2) == 0) {
+        if (strcmp(argv[arg], "--stats") == 0) {
+            show_stats = 1;
+            arg++;
+            continue;
+        }
+
+        if (strcmp(argv[arg], "--format") == 0 && output_format_parse(argv[arg + 1], &format) == 0) {
+            // Format chosen
+        } else if (strcmp(argv[arg], "--sink") == 0 && strcmp(argv[arg + 1], "file") == 0) {
+            to_file = 1, to_stdout = 0;
+        } else if (strcmp(argv[arg], "--sink") == 0 && strcmp(argv[arg + 1], "stdout") == 0) {
+            to_file = 0, to_stdout = 1;
+        } else if (strcmp(argv[arg], "--sink") == 0 && strcmp(argv[arg + 1], "both") == 0) {
+            to_file = 1, to_stdout = 1;
+        } else if (strcmp(argv[arg], "--sink") == 0 && strcmp(argv[arg + 1], "none") == 0) {
+            to_file = 0, to_stdout = 0;
+        } else if (strcmp(argv[arg], "--cache") == 0) {
+            cache_dir = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--cache-size") == 0 && atoi(argv[arg + 1]) > 0) {
+            cache_limit = (size_t)atoi(argv[arg + 1]) << 20;
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        arg += 2;
+    }
+
     // Ensure correct usage of the program with two arguments (input filename and output filename)
-    if (argc != 3) {
-        fprintf(stderr, "Error: Correct syntax: %s <input_file.bz> <output_file.bz>\n", argv[0]);
+    if (argc - arg != 2) {
+        print_usage(argv[0]);
         return EXIT_FAILURE;
     }
+    const char *input = argv[arg];
+    const char *output = argv[arg + 1];
 
     // Validate input file extension
-    check_file_type(argv[1], VALID_EXTENSION);
+    check_file_type(input, VALID_EXTENSION);
 
-    // Validate output file extension
-    check_file_type(argv[2], VALID_EXTENSION);
+    // Validate output file extension: .bz for text tokens, .bzt for a binary token file
+    const char *dot = strrchr(output, '.');
+    int binary = dot && strcmp(dot, TOKEN_FILE_EXTENSION) == 0;
+    if (!binary) {
+        check_file_type(output, VALID_EXTENSION);
+    }
 
-    // Open the input file for reading
-    FILE *file = fopen(argv[1], "r");
-    if (!file) {
-        fprintf(stderr, "Error: Unable to open file '%s'.\n", argv[1]);
+    // Map the input file into memory
+    STAT_START(read_started);
+    SourceBuffer source;
+    if (source_open(&source, input) != 0) {
+        fprintf(stderr, "Error: Unable to open file '%s'.\n", input);
         perror("File Error");
         return EXIT_FAILURE;
     }
 
-    // Debug: Check input file size
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    if (file_size == 0) {
+    if (source.length == 0) {
         fprintf(stderr, "Error: Input file is empty.\n");
-        fclose(file);
+        source_close(&source);
         return EXIT_FAILURE;
     }
+#ifdef LEX_STATS
+    uint64_t read_ticks = stats_clock() - read_started;
+#endif
 
     // Open the output file for writing
-    FILE *outputFile = fopen(argv[2], "w");
-    if (!outputFile) {
-        fprintf(stderr, "Error: Unable to create file '%s'.\n", argv[2]);
-        perror("File Error");
-        fclose(file);
-        return EXIT_FAILURE;
+    FILE *outputFile = NULL;
+    if (to_file) {
+        outputFile = fopen(output, binary ? "wb" : "w");
+        if (!outputFile) {
+            fprintf(stderr, "Error: Unable to create file '%s'.\n", output);
+            perror("File Error");
+            source_close(&source);
+            return EXIT_FAILURE;
+        }
     }
 
-    // Tokenize the input file
+    // Replay the tokens of an unchanged input from the cache
+    TokenCache cache;
+    int cached = cache_dir && cache_open(&cache, cache_dir, cache_limit) == 0;
+    if (cache_dir && !cached) {
+        fprintf(stderr, "Warning: Unable to use cache directory '%s'.\n", cache_dir);
+    }
+
+    LexerState state;
     size_t token_count = 0;
-    Token *tokens = lex(file, &token_count);
-    fclose(file);  // Close the input file after lexing
+    Token *tokens = NULL;
+    uint64_t key = 0;
+    if (cached) {
+        lexer_init(&state, source.data, source.length);
+        key = cache_key(&cache, source.data, source.length);
+        tokens = cache_load(&cache, key, &state, source.data, source.length, &token_count);
+        if (!tokens) {
+            lexer_free(&state); // lex_parallel starts from lexer_init
+        }
+    }
+
+    // Otherwise tokenize the input buffer, splitting large inputs across all cores
+    if (!tokens) {
+        tokens = lex_parallel(&state, source.data, source.length, 0, &token_count);
+        if (tokens && lexer_error(&state)) {
+            char reason[128];
+            lex_error_describe(&state, reason, sizeof(reason));
+            fprintf(stderr, "Error: %s\n", reason);
+            lexer_free(&state);
+            tokens = NULL;
+        }
+        if (tokens && cached) {
+            cache_store(&cache, key, source.data, tokens, token_count);
+        }
+    }
+    if (cached) {
+        cache_trim(&cache);
+        cache_close(&cache);
+    }
 
     if (!tokens) {
         fprintf(stderr, "Error: Failed to tokenize input file\n");
-        fclose(outputFile);
+        source_close(&source);
+        if (outputFile) {
+            fclose(outputFile);
+        }
         return EXIT_FAILURE;
     }
 
-    // Token type strings
-    char *token_type[] = {
-        "ADDITION", "SUBTRACTION", "MULTIPLICATION", "DIVISION", 
-        "MODULO", "EXPONENT", "INT_DIVISION", "ASSIGNMENT_OP",
-        "GREATER_THAN", "LESS_THAN", "IS_EQUAL_TO",
-        "GREATER_EQUAL", "LESS_EQUAL", "NOT_EQUAL",
-        "AND", "OR", "NOT",
-        "SEMICOLON", "COMMA", "LEFT_PAREN", "RIGHT_PAREN", "LEFT_BRACKET",
-        "RIGHT_BRACKET", "LEFT_BRACE", "RIGHT_BRACE", "DBL_QUOTE", "SNGL_QUOTE",
-        "BUZZ_TOKEN", "BEEGIN_TOKEN", "QUEENBEE_TOKEN", "BEEGONE_TOKEN", "FOR_TOKEN", "THIS_TOKEN", 
-        "IS_TOKEN", "WHILE_TOKEN", "DO_TOKEN", "UPTO_TOKEN", "DOWNTO_TOKEN", "HIVE_TOKEN", 
-        "SIZE_TOKEN", "STING_TOKEN", "IF_TOKEN", "RETURNS_TOKEN", "ELSEIF_TOKEN", "ELSE_TOKEN", 
-        "HOVER_TOKEN", "GATHER_TOKEN", "BUZZOUT_TOKEN", "SWITCH_TOKEN", "CASE_TOKEN",
-        "CHAR_TOKEN", "CHAIN_TOKEN", "INT_TOKEN", "FLOAT_TOKEN", "BOOL_TOKEN", "TRUE_TOKEN", "FALSE_TOKEN",
-        "INTEGER", "FLOAT", "STRING",
-        "COMMENT", "VAR_IDENT", "FUNC_IDENT", "NOISE_WORD", "INVALID", "END_OF_TOKENS"
-    };
-
-    // Write tokens to the output file and print to the console
-    fprintf(outputFile, "%-20s %-20s\n", "TOKEN", "TOKEN TYPE");
-    fprintf(outputFile, "--------------------------------------------\n");
-
-    printf("%-20s %-20s\n", "TOKEN", "TOKEN TYPE");
-    printf("--------------------------------------------\n");
-
-    for (int i = 0; tokens[i].type != END_OF_TOKENS; i++) {
-        fprintf(outputFile, "%-20s %-20s\n",
-                tokens[i].value ? tokens[i].value : "(null)", // Token value
-                token_type[tokens[i].type]);                 // Token type
-
-        printf("%-20s %-20s\n",
-               tokens[i].value ? tokens[i].value : "(null)", // Token value
-               token_type[tokens[i].type]);                  // Token type
-    }
-
-    // Free allocated memory for tokens
-    for (int i = 0; tokens[i].type != END_OF_TOKENS; i++) {
-        if (tokens[i].value) {
-            free(tokens[i].value);
+    STAT_ADD(&state, clock[PHASE_READ], read_ticks);
+
+    // Format the tokens once and hand the buffer to the output file and/or the console
+    STAT_START(output_started);
+    int status = EXIT_SUCCESS;
+    TokenSink sink;
+    sink_init(&sink, format);
+    if (outputFile && binary) {
+        if (token_file_write(outputFile, source.data, tokens, token_count) != 0) {
+            status = EXIT_FAILURE;
         }
+    } else if (outputFile) {
+        sink_add(&sink, outputFile);
+    }
+    if (to_stdout) {
+        sink_add(&sink, stdout);
+    }
+    sink_write_tokens(&sink, source.data, tokens);
+    if (sink_close(&sink) != 0) {
+        status = EXIT_FAILURE;
     }
-    free(tokens);
+    STAT_STOP(&state, PHASE_OUTPUT, output_started);
 
-    fclose(outputFile);  // Close the output file
-    printf("Lexical analysis complete. Tokens written to '%s'.\n", argv[2]);
+    // Free allocated memory for tokens, then the input they point into
+    lexer_free(&state);
+    source_close(&source);
 
-    return EXIT_SUCCESS;
+    if (outputFile && fclose(outputFile) != 0) {  // Close the output file
+        status = EXIT_FAILURE;
+    }
+    if (status != EXIT_SUCCESS) {
+        fprintf(stderr, "Error: Unable to write file '%s'.\n", output);
+    } else if (to_file) {
+        printf("Lexical analysis complete. Tokens written to '%s'.\n", output);
+    } else {
+        fprintf(stderr, "Lexical analysis complete. %zu tokens.\n", token_count);
+    }
+
+    // Counters go to stderr so they never mix with tokens on stdout
+    if (show_stats) {
+#ifdef LEX_STATS
+        stats_write_json(stderr, &state.stats);
+#else
+        fprintf(stderr, "Warning: --stats needs a build with -DLEX_STATS.\n");
+#endif
+    }
+
+    return status;
+}
+
+void print_usage(const char *program) {
+    fprintf(stderr, "Error: Correct syntax: %s [--format table|jsonl|tsv] [--sink file|stdout|both|none] [--cache <dir>] [--cache-size <MiB>] [--stats] <input_file.bz> <output_file.bz | output_file.bzt>\n", program);
+    fprintf(stderr, "       or: %s --batch [-j <workers>] [--format table|jsonl|tsv] [--cache <dir>] [--cache-size <MiB>] <output_dir> <input.bz | dir | @list>...\n", program);
+    fprintf(stderr, "       or: %s --serve [-j <workers>] [--max-token-length <bytes>] [--max-comment-length <bytes>] [--max-tokens <count>] [<socket>]\n", program);
 }
 
 // Function to check if the file extension is correct
@@ -118,3 +233,100 @@ void check_file_type(const char* filename, const char* expectedExtension) {
         exit(EXIT_FAILURE);
     }
 }
+
+// Lex every input into output_dir, spreading the files over all cores
+int run_batch(int argc, char *argv[]) {
+    int workers = cpu_count();
+    int arg = 2;
+
+    BatchList list = {0};
+    int status = EXIT_SUCCESS;
+    const char *cache_dir = NULL;
+    size_t cache_limit = TOKEN_CACHE_LIMIT;
+    TokenCache cache;
+
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-j") == 0) {
+            workers = atoi(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--cache") == 0) {
+            cache_dir = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--cache-size") == 0 && atoi(argv[arg + 1]) > 0) {
+            cache_limit = (size_t)atoi(argv[arg + 1]) << 20;
+        } else if (strcmp(argv[arg], "--format") != 0 || output_format_parse(argv[arg + 1], &list.format) != 0) {
+            workers = 0; // Unknown option
+            break;
+        }
+        arg += 2;
+    }
+
+    if (argc - arg < 2 || workers < 1) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *output_dir = argv[arg++];
+
+    if (cache_dir && cache_open(&cache, cache_dir, cache_limit) == 0) {
+        list.cache = &cache;
+    } else if (cache_dir) {
+        fprintf(stderr, "Warning: Unable to use cache directory '%s'.\n", cache_dir);
+    }
+
+    for (; arg < argc; arg++) {
+        if (batch_add(&list, argv[arg], output_dir) != 0) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    size_t failed = (size_t)batch_run(&list, workers, stdout);
+    if (failed != 0) {
+        status = EXIT_FAILURE;
+    }
+
+    if (list.cache) {
+        cache_trim(list.cache);
+        cache_close(list.cache);
+    }
+
+    printf("Lexical analysis complete. %zu file(s) written to '%s'.\n", list.count - failed, output_dir);
+    batch_free(&list);
+    return status;
+}
+
+// Lex requests from tools/lex_client until interrupted, with one warm lexer per worker
+int run_server(int argc, char *argv[]) {
+    int workers = cpu_count();
+    int arg = 2;
+    LexLimits limits = {SERVER_MAX_TOKEN_LENGTH, SERVER_MAX_COMMENT_LENGTH, SERVER_MAX_TOKENS};
+
+    // A limit of 0 turns that bound off
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-j") == 0) {
+            workers = atoi(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--max-token-length") == 0 && atoi(argv[arg + 1]) >= 0) {
+            limits.max_token_length = (size_t)atoi(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--max-comment-length") == 0 && atoi(argv[arg + 1]) >= 0) {
+            limits.max_comment_length = (size_t)atoi(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--max-tokens") == 0 && atoi(argv[arg + 1]) >= 0) {
+            limits.max_tokens = (size_t)atoi(argv[arg + 1]);
+        } else {
+            workers = 0; // Unknown option
+            break;
+        }
+        arg += 2;
+    }
+
+    if (argc - arg > 1 || workers < 1 || (arg < argc && argv[arg][0] == '-')) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *socket_path = getenv(SERVER_SOCKET_VARIABLE);
+    if (arg < argc) {
+        socket_path = argv[arg];
+    } else if (!socket_path || !*socket_path) {
+        socket_path = SERVER_DEFAULT_SOCKET;
+    }
+
+    return server_run(socket_path, workers, &limits) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
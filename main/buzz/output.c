@@ -0,0 +1,251 @@
+#include "output.h"
+#include "lines.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TABLE_WIDTH 20
+
+// Append a string literal without counting its length by hand
+#define PUT_LITERAL(p, literal) put_text((p), (literal), sizeof(literal) - 1)
+
+int output_format_parse(const char *name, OutputFormat *format) {
+    if (strcmp(name, "table") == 0) {
+        *format = OUTPUT_TABLE;
+    } else if (strcmp(name, "jsonl") == 0) {
+        *format = OUTPUT_JSONL;
+    } else if (strcmp(name, "tsv") == 0) {
+        *format = OUTPUT_TSV;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+void sink_init(TokenSink *sink, OutputFormat format) {
+    sink->format = format;
+    sink->file_count = 0;
+    sink->failed = 0;
+    sink->buffer = NULL;
+    sink->length = 0;
+    sink->capacity = 0;
+}
+
+void sink_add(TokenSink *sink, FILE *out) {
+    if (sink->file_count < OUTPUT_MAX_FILES) {
+        sink->files[sink->file_count++] = out;
+    }
+}
+
+// Write out everything buffered so far; -1 if any file failed since the sink was opened
+int sink_flush(TokenSink *sink) {
+    for (int i = 0; i < sink->file_count && sink->length > 0; i++) {
+        if (fwrite(sink->buffer, 1, sink->length, sink->files[i]) != sink->length) {
+            sink->failed = 1;
+        }
+    }
+    sink->length = 0;
+    return sink->failed ? -1 : 0;
+}
+
+// Flush, then make room for 'needed' more bytes
+static char *reserve(TokenSink *sink, size_t needed) {
+    if (sink->length + needed > sink->capacity) {
+        sink_flush(sink);
+    }
+
+    if (needed > sink->capacity) {
+        size_t capacity = needed > OUTPUT_BUFFER ? needed : OUTPUT_BUFFER;
+        char *buffer = realloc(sink->buffer, capacity);
+        if (!buffer) {
+            perror("Failed to allocate memory for output buffer");
+            exit(EXIT_FAILURE);
+        }
+        sink->buffer = buffer;
+        sink->capacity = capacity;
+    }
+
+    return sink->buffer + sink->length;
+}
+
+static char *put_text(char *p, const char *text, size_t length) {
+    memcpy(p, text, length);
+    return p + length;
+}
+
+static char *put_padded(char *p, const char *text, size_t length, size_t width) {
+    p = put_text(p, text, length);
+    if (length < width) {
+        memset(p, ' ', width - length);
+        p += width - length;
+    }
+    return p;
+}
+
+static char *put_uint(char *p, unsigned int value) {
+    char digits[10];
+    int count = 0;
+
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    while (count > 0) {
+        *p++ = digits[--count];
+    }
+    return p;
+}
+
+// JSON string body: quotes, backslashes and control characters escaped (worst case 6 bytes per byte)
+static char *put_json(char *p, const char *text, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+
+    for (size_t i = 0; i < length; i++) {
+        unsigned char ch = (unsigned char)text[i];
+        if (ch == '"' || ch == '\\') {
+            *p++ = '\\';
+            *p++ = (char)ch;
+        } else if (ch == '\n') {
+            *p++ = '\\';
+            *p++ = 'n';
+        } else if (ch == '\r') {
+            *p++ = '\\';
+            *p++ = 'r';
+        } else if (ch == '\t') {
+            *p++ = '\\';
+            *p++ = 't';
+        } else if (ch < 0x20) {
+            p = PUT_LITERAL(p, "\\u00");
+            *p++ = hex[ch >> 4];
+            *p++ = hex[ch & 0xf];
+        } else {
+            *p++ = (char)ch;
+        }
+    }
+    return p;
+}
+
+// TSV field: tabs, newlines and backslashes escaped (worst case 2 bytes per byte)
+static char *put_tsv(char *p, const char *text, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        char ch = text[i];
+        if (ch == '\t' || ch == '\n' || ch == '\r' || ch == '\\') {
+            *p++ = '\\';
+            *p++ = ch == '\t' ? 't' : ch == '\n' ? 'n' : ch == '\r' ? 'r' : '\\';
+        } else {
+            *p++ = ch;
+        }
+    }
+    return p;
+}
+
+static void put_header(TokenSink *sink) {
+    char *p;
+
+    switch (sink->format) {
+        case OUTPUT_TABLE:
+            p = reserve(sink, 2 * TABLE_WIDTH + 2 + 45);
+            p = put_padded(p, "TOKEN", 5, TABLE_WIDTH);
+            *p++ = ' ';
+            p = put_padded(p, "TOKEN TYPE", 10, TABLE_WIDTH);
+            p = PUT_LITERAL(p, "\n--------------------------------------------\n");
+            break;
+
+        case OUTPUT_TSV:
+            p = reserve(sink, 32);
+            p = PUT_LITERAL(p, "text\ttype\tline\tcolumn\n");
+            break;
+
+        default:
+            return; // JSON Lines has no header
+    }
+
+    sink->length = p - sink->buffer;
+}
+
+static void put_token(TokenSink *sink, const char *source, const Token *token, unsigned int line, unsigned int column) {
+    const char *text = token_text(source, token);
+    const char *name = token_name(token->type);
+    size_t name_length = strlen(name);
+    char *p;
+
+    switch (sink->format) {
+        case OUTPUT_TABLE:
+            p = reserve(sink, token->length + name_length + 2 * TABLE_WIDTH + 2);
+            p = put_padded(p, text, token->length, TABLE_WIDTH);
+            *p++ = ' ';
+            p = put_padded(p, name, name_length, TABLE_WIDTH);
+            *p++ = '\n';
+            break;
+
+        case OUTPUT_JSONL:
+            p = reserve(sink, 6 * (size_t)token->length + name_length + 64);
+            p = PUT_LITERAL(p, "{\"type\":\"");
+            p = put_text(p, name, name_length);
+            p = PUT_LITERAL(p, "\",\"text\":\"");
+            p = put_json(p, text, token->length);
+            p = PUT_LITERAL(p, "\",\"line\":");
+            p = put_uint(p, line);
+            p = PUT_LITERAL(p, ",\"column\":");
+            p = put_uint(p, column);
+            p = PUT_LITERAL(p, "}\n");
+            break;
+
+        case OUTPUT_TSV:
+            p = reserve(sink, 2 * (size_t)token->length + name_length + 32);
+            p = put_tsv(p, text, token->length);
+            *p++ = '\t';
+            p = put_text(p, name, name_length);
+            *p++ = '\t';
+            p = put_uint(p, line);
+            *p++ = '\t';
+            p = put_uint(p, column);
+            *p++ = '\n';
+            break;
+
+        default:
+            return;
+    }
+
+    sink->length = p - sink->buffer;
+}
+
+// Format a whole END_OF_TOKENS-terminated array; nothing is formatted when no file is attached
+void sink_write_tokens(TokenSink *sink, const char *source, const Token *tokens) {
+    if (sink->file_count == 0) {
+        return;
+    }
+
+    // Tokens come in source order, so their positions are found walking forward; the table has none
+    LineCursor cursor;
+    unsigned int line = 0, column = 0;
+    line_cursor_init(&cursor, source);
+
+    put_header(sink);
+    for (size_t i = 0; tokens[i].type != END_OF_TOKENS; i++) {
+        if (sink->format != OUTPUT_TABLE) {
+            line_cursor_seek(&cursor, tokens[i].offset, &line, &column);
+        }
+        put_token(sink, source, &tokens[i], line, column);
+    }
+}
+
+// Flush and release the buffer; the files stay open
+int sink_close(TokenSink *sink) {
+    int status = sink_flush(sink);
+    free(sink->buffer);
+    sink_init(sink, sink->format);
+    return status;
+}
+
+// Write the token array to one file in the given format
+int write_tokens(FILE *out, OutputFormat format, const char *source, const Token *tokens) {
+    TokenSink sink;
+
+    sink_init(&sink, format);
+    sink_add(&sink, out);
+    sink_write_tokens(&sink, source, tokens);
+    return sink_close(&sink);
+}
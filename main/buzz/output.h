@@ -0,0 +1,37 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+
+#include "lex.h"
+
+#define OUTPUT_BUFFER (1 << 20)
+#define OUTPUT_MAX_FILES 2
+
+typedef enum {
+    OUTPUT_TABLE,   // TOKEN / TOKEN TYPE columns padded to 20
+    OUTPUT_JSONL,   // One JSON object per token
+    OUTPUT_TSV      // text, type, line, column separated by tabs
+} OutputFormat;
+
+// Formats tokens into one large buffer and hands it to every attached file in big writes
+typedef struct {
+    OutputFormat format;
+    FILE *files[OUTPUT_MAX_FILES];
+    int file_count;             // No files: tokens are formatted nowhere
+    int failed;                 // A write to one of the files failed
+    char *buffer;
+    size_t length;
+    size_t capacity;
+} TokenSink;
+
+// Function Prototypes
+int output_format_parse(const char *name, OutputFormat *format);
+void sink_init(TokenSink *sink, OutputFormat format);
+void sink_add(TokenSink *sink, FILE *out);
+void sink_write_tokens(TokenSink *sink, const char *source, const Token *tokens);
+int sink_flush(TokenSink *sink);
+int sink_close(TokenSink *sink);
+int write_tokens(FILE *out, OutputFormat format, const char *source, const Token *tokens);
+
+#endif
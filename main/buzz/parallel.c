@@ -0,0 +1,270 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "parallel.h"
+#include "lex.h"
+#include "charclass.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// One slice of the input, lexed speculatively as if no token crossed into it
+typedef struct {
+    LexerState state;
+    const char *start;
+    const char *end;
+
+    // Where each token group begins, used to resynchronise with the chunk before
+    const char **group_starts;
+    size_t *group_tokens;
+    size_t groups;
+    size_t groups_capacity;
+} Chunk;
+
+int cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+#endif
+}
+
+// Prefer to split after a newline, which only a comment runs across, otherwise after any blank
+static const char *split_point(const char *from, const char *limit) {
+    const char *newline = memchr(from, '\n', limit - from);
+    if (newline) {
+        return newline + 1;
+    }
+
+    for (const char *p = from; p < limit; p++) {
+        if (charClass((unsigned char)*p) & CHAR_SPACE) {
+            return p + 1;
+        }
+    }
+
+    return from; // No blank at all: resynchronisation still keeps the result exact
+}
+
+static void record_group(Chunk *chunk, const char *start, size_t first_token) {
+    if (chunk->groups == chunk->groups_capacity) {
+        size_t capacity = chunk->groups_capacity ? chunk->groups_capacity * 2
+                                                 : LEX_PREDICT_TOKENS((size_t)(chunk->end - chunk->start));
+        const char **starts = realloc(chunk->group_starts, sizeof(const char *) * capacity);
+        size_t *tokens = realloc(chunk->group_tokens, sizeof(size_t) * capacity);
+        if (!starts || !tokens) {
+            perror("Failed to allocate memory for chunk groups");
+            exit(EXIT_FAILURE);
+        }
+        chunk->group_starts = starts;
+        chunk->group_tokens = tokens;
+        chunk->groups_capacity = capacity;
+    }
+
+    chunk->group_starts[chunk->groups] = start;
+    chunk->group_tokens[chunk->groups] = first_token;
+    chunk->groups++;
+}
+
+// First group of the chunk that starts exactly at 'position', or chunk->groups if none does
+static size_t find_group(const Chunk *chunk, const char *position) {
+    size_t low = 0, high = chunk->groups;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (chunk->group_starts[mid] < position) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low < chunk->groups && chunk->group_starts[low] == position) {
+        return low;
+    }
+    return chunk->groups;
+}
+
+// Speculative pass: lex every group that starts inside the chunk (offsets are already file offsets)
+static void *lex_chunk(void *arg) {
+    Chunk *chunk = arg;
+    LexerState *state = &chunk->state;
+
+    state->cursor = chunk->start;
+    state->stop = chunk->end;
+    lexer_start(state);
+    lexer_reserve(state, LEX_PREDICT_TOKENS((size_t)(chunk->end - chunk->start)));
+
+    for (;;) {
+        skipBlanks(state);
+        if (state->cursor >= state->stop) {
+            break;
+        }
+        record_group(chunk, state->cursor, state->tokens_index);
+        lexNext(state);
+    }
+
+    return NULL;
+}
+
+/* Second pass for a chunk whose speculative start was wrong because a token
+   (typically a <| ... :> comment) ran into it from the chunk before. Lex
+   serially from the real resume point and hand back to the speculative
+   tokens as soon as a group starts where one of theirs does. Returns the
+   index of the first speculative group that can be kept, or chunk->groups
+   (also when a token too long to store stopped it; 'out' then has the error). */
+static size_t relex_chunk(LexerState *out, Chunk *chunk, const char **resume) {
+    LexerState relex;
+    size_t synced = chunk->groups;
+
+    lexer_init(&relex, out->source, out->source_end - out->source);
+    relex.cursor = *resume;
+    relex.stop = chunk->end;
+    lexer_start(&relex);
+
+    for (;;) {
+        skipBlanks(&relex);
+        if (relex.cursor >= relex.stop) {
+            break;
+        }
+        if ((synced = find_group(chunk, relex.cursor)) < chunk->groups) {
+            break;
+        }
+        lexNext(&relex);
+    }
+
+    size_t count;
+    Token *tokens = lexer_finish(&relex, &count);
+    lexer_append(out, tokens, count);
+    if (lexer_error(&relex)) {
+        out->error = relex.error;
+        synced = chunk->groups;
+    }
+    arena_merge(&out->arena, &relex.arena);
+#ifdef LEX_STATS
+    stats_merge(&out->stats, &relex.stats);
+#endif
+    free(tokens);
+    symbols_free(&relex.symbols); // lexer_append interned the kept identifiers into 'out'
+
+    *resume = relex.cursor;
+    return synced;
+}
+
+Token *lex_parallel(LexerState *state, const char *source, size_t length, int workers, size_t *token_count) {
+    if (workers <= 0) {
+        workers = cpu_count();
+    }
+
+    size_t chunk_count = length / PARALLEL_MIN_CHUNK;
+    if (chunk_count > (size_t)workers) {
+        chunk_count = workers;
+    }
+    if (chunk_count < 2) {
+        return lex_buffer(state, source, length, token_count);
+    }
+
+    Chunk *chunks = calloc(chunk_count, sizeof(Chunk));
+    pthread_t *threads = malloc(sizeof(pthread_t) * chunk_count);
+    if (!chunks || !threads) {
+        perror("Failed to allocate memory for chunks");
+        exit(EXIT_FAILURE);
+    }
+
+    // Split at blanks near equal offsets
+    const char *end = source + length;
+    const char *previous = source;
+    for (size_t i = 0; i < chunk_count; i++) {
+        chunks[i].start = previous;
+        if (i + 1 == chunk_count) {
+            chunks[i].end = end;
+        } else {
+            const char *target = source + length / chunk_count * (i + 1);
+            const char *limit = source + length / chunk_count * (i + 2);
+            if (target < previous) {
+                target = previous;
+            }
+            chunks[i].end = split_point(target, limit);
+        }
+        previous = chunks[i].end;
+        lexer_init(&chunks[i].state, source, length);
+    }
+
+    // Speculative pass, chunk 0 on the calling thread
+    for (size_t i = 1; i < chunk_count; i++) {
+        if (pthread_create(&threads[i], NULL, lex_chunk, &chunks[i]) != 0) {
+            perror("Failed to start chunk thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+    lex_chunk(&chunks[0]);
+    for (size_t i = 1; i < chunk_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // Merge in order, keeping speculative tokens only from the group where the real lexer resumes
+    lexer_init(state, source, length);
+    size_t total = 0;
+    for (size_t i = 0; i < chunk_count; i++) {
+        total += chunks[i].state.tokens_index; // Nearly always exact; relexing rarely adds more
+    }
+    lexer_reserve(state, total);
+    const char *resume = source;
+
+    for (size_t i = 0; i < chunk_count; i++) {
+        Chunk *chunk = &chunks[i];
+        size_t count;
+        Token *tokens = lexer_finish(&chunk->state, &count);
+        size_t keep = chunk->groups;
+
+        if (lexer_error(state)) {
+            keep = chunk->groups; // Nothing after the error is kept
+        } else if (i == 0) {
+            keep = 0; // The first chunk starts where the real lexer does
+        } else if (resume < chunk->end) {
+            keep = find_group(chunk, resume);
+            if (keep == chunk->groups) {
+                keep = relex_chunk(state, chunk, &resume);
+            }
+        }
+
+        if (keep < chunk->groups) {
+            size_t first = chunk->group_tokens[keep];
+            lexer_append(state, tokens + first, count - first);
+            resume = chunk->state.cursor;
+
+            // A chunk stops at the first token too long to store, which is on the real path when its groups are kept
+            if (lexer_error(&chunk->state)) {
+                state->error = chunk->state.error;
+            }
+        }
+
+        // Discarded speculative values stay in the arena until the caller frees the state
+        arena_merge(&state->arena, &chunk->state.arena);
+#ifdef LEX_STATS
+        stats_merge(&state->stats, &chunk->state.stats); // Includes speculative work that was thrown away
+#endif
+        free(tokens);
+        symbols_free(&chunk->state.symbols);
+        free(chunk->group_starts);
+        free(chunk->group_tokens);
+    }
+
+    free(chunks);
+    free(threads);
+
+    if (!state->tokens) {
+        lexer_append(state, NULL, 0);
+    }
+    state->cursor = resume;
+    return lexer_finish(state, token_count);
+}
@@ -0,0 +1,12 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// Inputs are only split when every chunk gets at least this many bytes
+#ifndef PARALLEL_MIN_CHUNK
+#define PARALLEL_MIN_CHUNK (1 << 20)
+#endif
+
+// Function Prototypes
+int cpu_count(void);
+
+#endif
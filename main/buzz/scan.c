@@ -0,0 +1,129 @@
+#include "scan.h"
+#include "charclass.h"
+
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#define SCAN_BLOCK 64
+
+#if defined(__AVX2__)
+
+// Unsigned lo <= byte <= hi for every byte
+static __m256i in_range(__m256i v, char lo, char hi) {
+    __m256i shifted = _mm256_xor_si256(_mm256_sub_epi8(v, _mm256_set1_epi8(lo)), _mm256_set1_epi8((char)0x80));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + (hi - lo + 1))), shifted);
+}
+
+static void classify(const char *p, uint64_t bits[SCAN_CLASSES], int shift) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+
+    __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), in_range(v, '\t', '\r'));
+    __m256i alpha = in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+    __m256i digit = in_range(v, '0', '9');
+    __m256i word = _mm256_or_si256(_mm256_or_si256(alpha, digit), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+
+    bits[SCAN_SPACE] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(space) << shift;
+    bits[SCAN_ALPHA] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(alpha) << shift;
+    bits[SCAN_DIGIT] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(digit) << shift;
+    bits[SCAN_WORD] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(word) << shift;
+}
+
+#define CLASSIFY_WIDTH 32
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+// Unsigned lo <= byte <= hi for every byte
+static __m128i in_range(__m128i v, char lo, char hi) {
+    __m128i shifted = _mm_xor_si128(_mm_sub_epi8(v, _mm_set1_epi8(lo)), _mm_set1_epi8((char)0x80));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(0x80 + (hi - lo + 1))));
+}
+
+static void classify(const char *p, uint64_t bits[SCAN_CLASSES], int shift) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+
+    __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), in_range(v, '\t', '\r'));
+    __m128i alpha = in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+    __m128i digit = in_range(v, '0', '9');
+    __m128i word = _mm_or_si128(_mm_or_si128(alpha, digit), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+
+    bits[SCAN_SPACE] |= (uint64_t)_mm_movemask_epi8(space) << shift;
+    bits[SCAN_ALPHA] |= (uint64_t)_mm_movemask_epi8(alpha) << shift;
+    bits[SCAN_DIGIT] |= (uint64_t)_mm_movemask_epi8(digit) << shift;
+    bits[SCAN_WORD] |= (uint64_t)_mm_movemask_epi8(word) << shift;
+}
+
+#define CLASSIFY_WIDTH 16
+
+#else
+
+// Portable fallback, one table lookup per byte
+static void classify(const char *p, uint64_t bits[SCAN_CLASSES], int shift) {
+    for (int i = 0; i < 8; i++) {
+        int cls = char_class_table[(unsigned char)p[i]];
+        uint64_t bit = (uint64_t)1 << (shift + i);
+
+        if (cls & CHAR_SPACE) {
+            bits[SCAN_SPACE] |= bit;
+        }
+        if (cls & CHAR_IDENT_START) {
+            bits[SCAN_ALPHA] |= bit;
+        }
+        if (cls & CHAR_DIGIT) {
+            bits[SCAN_DIGIT] |= bit;
+        }
+        if (cls & CHAR_IDENT_CONT) {
+            bits[SCAN_WORD] |= bit;
+        }
+    }
+}
+
+#define CLASSIFY_WIDTH 8
+
+#endif
+
+void scan_reset(ScanCache *cache) {
+    cache->base = NULL;
+}
+
+// Stage one: classify up to 64 bytes; bytes past 'length' belong to no class
+void scan_block(const char *block, size_t length, uint64_t bits[SCAN_CLASSES]) {
+    char padded[SCAN_BLOCK];
+
+    if (length < SCAN_BLOCK) {
+        memset(padded, 0, sizeof(padded));
+        memcpy(padded, block, length);
+        block = padded;
+    }
+
+    memset(bits, 0, sizeof(uint64_t) * SCAN_CLASSES);
+    for (int shift = 0; shift < SCAN_BLOCK; shift += CLASSIFY_WIDTH) {
+        classify(block + shift, bits, shift);
+    }
+}
+
+/* Stage two: first byte at or after 'from' that is not in 'cls', or
+   source_end. Blocks are counted from the start of the source, so a file
+   lexed from front to back indexes every block once. */
+const char *scan_run(ScanCache *cache, const char *source, const char *source_end,
+                     const char *from, ScanClass cls) {
+    while (from < source_end) {
+        const char *base = source + ((size_t)(from - source) & ~(size_t)(SCAN_BLOCK - 1));
+        if (cache->base != base) {
+            size_t length = source_end - base;
+            scan_block(base, length < SCAN_BLOCK ? length : SCAN_BLOCK, cache->bits);
+            cache->base = base;
+        }
+
+        uint64_t outside = ~cache->bits[cls] >> (from - base);
+        if (outside != 0) {
+            const char *end = from + count_trailing_zeros(outside);
+            return end < source_end ? end : source_end;
+        }
+        from = base + SCAN_BLOCK;
+    }
+
+    return source_end;
+}
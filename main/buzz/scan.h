@@ -0,0 +1,43 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Character classes tracked by the structural index
+typedef enum {
+    SCAN_SPACE,     // ' ', '\t', '\n', '\v', '\f', '\r'
+    SCAN_ALPHA,     // A-Z, a-z
+    SCAN_DIGIT,     // 0-9
+    SCAN_WORD,      // Identifier body: letters, digits and '_'
+    SCAN_CLASSES
+} ScanClass;
+
+// Bitmaps of one 64-byte block of the source, bit i standing for byte i
+typedef struct {
+    const char *base;               // Start of the indexed block, NULL when nothing is cached
+    uint64_t bits[SCAN_CLASSES];
+} ScanCache;
+
+// Index of the lowest set bit of a block bitmap ('bits' is not 0)
+static inline int count_trailing_zeros(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (int)index;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+// Function Prototypes
+void scan_reset(ScanCache *cache);
+void scan_block(const char *block, size_t length, uint64_t bits[SCAN_CLASSES]);
+const char *scan_run(ScanCache *cache, const char *source, const char *source_end,
+                     const char *from, ScanClass cls);
+
+#endif
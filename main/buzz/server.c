@@ -0,0 +1,363 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "server.h"
+#include "lex.h"
+#include "source.h"
+#include "output.h"
+#include "tokenfile.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+
+int server_run(const char *socket_path, int workers, const LexLimits *limits) {
+    (void)socket_path;
+    (void)workers;
+    (void)limits;
+    fprintf(stderr, "Error: The lexing server needs Unix domain sockets.\n");
+    return -1;
+}
+
+#else
+
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#define SERVER_BACKLOG 64
+#define SERVER_EXTENSION ".bz"
+
+typedef struct {
+    int listener;
+    LexLimits limits;
+    volatile sig_atomic_t stopping;
+} Server;
+
+// One thread of the pool; its state and input buffer stay warm from one request to the next
+typedef struct {
+    Server *server;
+    pthread_t thread;
+    LexerState state;
+    char *input;            // Inline sources
+    size_t input_capacity;
+    size_t requests;
+    size_t failed;
+} ServerWorker;
+
+static int read_full(int fd, void *data, size_t length) {
+    char *p = data;
+
+    while (length > 0) {
+        ssize_t got = read(fd, p, length);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return -1;
+        }
+        p += got;
+        length -= (size_t)got;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void *data, size_t length) {
+    const char *p = data;
+
+    while (length > 0) {
+        ssize_t put = write(fd, p, length);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put <= 0) {
+            return -1;
+        }
+        p += put;
+        length -= (size_t)put;
+    }
+    return 0;
+}
+
+static int send_reply(int fd, int status) {
+    unsigned char reply[SERVER_REPLY_SIZE] = {0};
+    memcpy(reply, SERVER_MAGIC, 4);
+    reply[4] = SERVER_VERSION;
+    reply[5] = (unsigned char)status;
+    return write_full(fd, reply, sizeof(reply));
+}
+
+static void send_error(int fd, int status, const char *message) {
+    if (send_reply(fd, status) == 0) {
+        write_full(fd, message, strlen(message));
+    }
+}
+
+// Lex 'length' bytes and stream the tokens back in 'format'
+static int send_tokens(ServerWorker *self, int fd, const char *data, size_t length, int format) {
+    LexerState *state = &self->state;
+    size_t count;
+
+    lexer_reset(state, data, length);
+    size_t predicted = LEX_PREDICT_TOKENS(length);
+    if (state->limits.max_tokens && predicted > state->limits.max_tokens) {
+        predicted = state->limits.max_tokens;
+    }
+    lexer_reserve(state, predicted); // Nothing to do once the worker is warm
+    while (lexNext(state)) {
+        // Tokens go straight into the reused array
+    }
+    Token *tokens = lexer_finish(state, &count);
+
+    if (lexer_error(state)) {
+        char reason[128], message[160];
+        lex_error_describe(state, reason, sizeof(reason));
+        snprintf(message, sizeof(message), "Error: %s\n", reason);
+        send_error(fd, SERVER_LIMIT, message);
+        return -1;
+    }
+
+    int copy = dup(fd);
+    FILE *out = copy >= 0 ? fdopen(copy, "wb") : NULL;
+    if (!out) {
+        if (copy >= 0) {
+            close(copy);
+        }
+        send_error(fd, SERVER_FAILED, "Error: Unable to write the reply.\n");
+        return -1;
+    }
+
+    int status = send_reply(fd, SERVER_OK);
+    if (status == 0 && format == SERVER_TOKEN_FILE) {
+        status = token_file_write(out, data, tokens, count);
+    } else if (status == 0) {
+        TokenSink sink;
+        sink_init(&sink, (OutputFormat)(format - SERVER_TABLE));
+        sink_add(&sink, out);
+        sink_write_tokens(&sink, data, tokens);
+        status = sink_close(&sink);
+    }
+
+    if (fclose(out) != 0) {
+        status = -1;
+    }
+    return status;
+}
+
+static int has_extension(const char *path, const char *extension) {
+    const char *dot = strrchr(path, '.');
+    return dot && strcmp(dot, extension) == 0;
+}
+
+static int serve_request(ServerWorker *self, int fd) {
+    unsigned char request[SERVER_REQUEST_SIZE];
+
+    errno = 0;
+    if (read_full(fd, request, sizeof(request)) != 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) { // After a timeout nobody is there to read an error
+            send_error(fd, SERVER_FAILED, "Error: Malformed request.\n");
+        }
+        return -1;
+    }
+    if (memcmp(request, SERVER_MAGIC, 4) != 0 ||
+        request[4] != SERVER_VERSION || request[6] > SERVER_TSV) {
+        send_error(fd, SERVER_FAILED, "Error: Malformed request.\n");
+        return -1;
+    }
+    int kind = request[5];
+    int format = request[6];
+    uint64_t length = server_get_u64(request + 8);
+
+    if (kind == SERVER_INLINE) {
+        if (length > SERVER_MAX_INLINE) {
+            send_error(fd, SERVER_FAILED, "Error: Input is too large to send inline.\n");
+            return -1;
+        }
+        if (length > self->input_capacity) {
+            char *input = realloc(self->input, (size_t)length);
+            if (!input) {
+                send_error(fd, SERVER_FAILED, "Error: Out of memory.\n");
+                return -1;
+            }
+            self->input = input;
+            self->input_capacity = (size_t)length;
+        }
+        if (read_full(fd, self->input, (size_t)length) != 0) {
+            return -1;
+        }
+        return send_tokens(self, fd, self->input, (size_t)length, format);
+    }
+
+    if (kind != SERVER_PATH || length == 0 || length >= PATH_MAX) {
+        send_error(fd, SERVER_FAILED, "Error: Malformed request.\n");
+        return -1;
+    }
+
+    char path[PATH_MAX];
+    if (read_full(fd, path, (size_t)length) != 0) {
+        return -1;
+    }
+    path[length] = '\0';
+
+    char message[PATH_MAX + 64];
+    // A relative path would be taken from the server's working directory, not the client's
+    if (path[0] != '/') {
+        snprintf(message, sizeof(message), "Error: Path '%s' is not absolute.\n", path);
+        send_error(fd, SERVER_FAILED, message);
+        return -1;
+    }
+    if (!has_extension(path, SERVER_EXTENSION)) {
+        snprintf(message, sizeof(message), "Error: Invalid file type '%s'. Expected '%s'.\n", path, SERVER_EXTENSION);
+        send_error(fd, SERVER_FAILED, message);
+        return -1;
+    }
+
+    SourceBuffer source;
+    if (source_open(&source, path) != 0) {
+        snprintf(message, sizeof(message), "Error: Unable to open file '%s'.\n", path);
+        send_error(fd, SERVER_FAILED, message);
+        return -1;
+    }
+    if (source.length == 0) {
+        send_error(fd, SERVER_FAILED, "Error: Input file is empty.\n");
+        source_close(&source);
+        return -1;
+    }
+
+    int status = send_tokens(self, fd, source.data, source.length, format);
+    source_close(&source);
+    return status;
+}
+
+static void *server_worker(void *arg) {
+    ServerWorker *self = arg;
+
+    for (;;) {
+        int fd = accept(self->server->listener, NULL, NULL);
+        if (fd < 0) {
+            if (self->server->stopping) {
+                break;
+            }
+            continue; // EINTR, or a connection that went away before it was accepted
+        }
+
+        // A client that stops sending (or reading) would otherwise hold this worker forever
+        struct timeval timeout = {SERVER_TIMEOUT, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        if (serve_request(self, fd) != 0) {
+            self->failed++;
+        }
+        self->requests++;
+        close(fd);
+    }
+
+    return NULL;
+}
+
+static int open_listener(const char *socket_path) {
+    struct sockaddr_un address;
+
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: Socket path '%s' is too long.\n", socket_path);
+        return -1;
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("Failed to create socket");
+        return -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    unlink(socket_path); // A socket left behind by a server that did not shut down cleanly
+
+    // The server reads any file its user can, so only that user may connect
+    mode_t mask = umask(077);
+    int bound = bind(listener, (struct sockaddr *)&address, sizeof(address));
+    umask(mask);
+
+    if (bound != 0 || listen(listener, SERVER_BACKLOG) != 0) {
+        fprintf(stderr, "Error: Unable to listen on '%s'.\n", socket_path);
+        perror("Socket Error");
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+/* Serve lex requests on 'socket_path' with 'workers' threads until SIGINT or
+   SIGTERM, refusing inputs that break 'limits'; returns 0 after a clean
+   shutdown, -1 if the server could not start. */
+int server_run(const char *socket_path, int workers, const LexLimits *limits) {
+    Server server = {0};
+    server.limits = *limits;
+    server.listener = open_listener(socket_path);
+    if (server.listener < 0) {
+        return -1;
+    }
+
+    // Workers never see the stop signals; this thread waits for them below
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+    signal(SIGPIPE, SIG_IGN); // A client that hangs up only fails its own request
+
+    ServerWorker *pool = calloc((size_t)workers, sizeof(ServerWorker));
+    if (!pool) {
+        perror("Failed to allocate memory for server workers");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < workers; i++) {
+        pool[i].server = &server;
+        lexer_init(&pool[i].state, NULL, 0);
+        lexer_limit(&pool[i].state, &server.limits); // Kept by lexer_reset from here on
+        if (pthread_create(&pool[i].thread, NULL, server_worker, &pool[i]) != 0) {
+            perror("Failed to start server thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("Serving lex requests on '%s' with %d worker(s).\n", socket_path, workers);
+    fflush(stdout);
+
+    int signal_number;
+    sigwait(&stop_signals, &signal_number);
+
+    // Wake every worker blocked in accept
+    server.stopping = 1;
+    shutdown(server.listener, SHUT_RDWR);
+
+    size_t requests = 0, failed = 0;
+    for (int i = 0; i < workers; i++) {
+        pthread_join(pool[i].thread, NULL);
+        requests += pool[i].requests;
+        failed += pool[i].failed;
+        lexer_free(&pool[i].state);
+        free(pool[i].input);
+    }
+    free(pool);
+
+    close(server.listener);
+    unlink(socket_path);
+    printf("Server stopped. %zu request(s) served, %zu failed.\n", requests, failed);
+    return 0;
+}
+
+#endif
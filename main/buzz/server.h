@@ -0,0 +1,64 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lex.h"
+
+/* Lexing over a local (Unix domain) socket, one request per connection:
+
+   request   "BZLX", u8 version, u8 kind, u8 format, u8 0, u64 payload length
+             then the payload: a path (SERVER_PATH) or the source itself (SERVER_INLINE)
+   reply     "BZLX", u8 version, u8 status, u8 0, u8 0
+             then, until the server closes the connection, the tokens in the
+             requested format, or an error message when status is not 0
+
+   Integers are little-endian. The client shuts down its side after the request. */
+
+#define SERVER_MAGIC "BZLX"
+#define SERVER_VERSION 1
+#define SERVER_REQUEST_SIZE 16
+#define SERVER_REPLY_SIZE 8
+#define SERVER_MAX_INLINE ((uint64_t)1 << 30)   // Largest source sent in a request
+#define SERVER_TIMEOUT 10   // Seconds a connection may stall, sending or reading, before the server drops it
+#define SERVER_DEFAULT_SOCKET "/tmp/buzz-lex.sock"
+#define SERVER_SOCKET_VARIABLE "BUZZ_LEX_SOCKET" // Environment variable overriding the default
+
+// What the payload is
+#define SERVER_PATH 1       // Absolute path of a .bz file the server reads itself
+#define SERVER_INLINE 2     // The source bytes
+
+// Reply format: a binary token file (.bzt), or 1 + an OutputFormat
+#define SERVER_TOKEN_FILE 0
+#define SERVER_TABLE 1
+#define SERVER_JSONL 2
+#define SERVER_TSV 3
+
+// Bounds on every request unless --serve is given others (see LexLimits)
+#define SERVER_MAX_TOKEN_LENGTH ((size_t)1 << 16)
+#define SERVER_MAX_COMMENT_LENGTH ((size_t)1 << 24)
+#define SERVER_MAX_TOKENS ((size_t)1 << 26)
+
+#define SERVER_OK 0
+#define SERVER_FAILED 1
+#define SERVER_LIMIT 2      // The input broke one of the server's LexLimits; the body says which and where
+
+static inline void server_put_u64(unsigned char *p, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static inline uint64_t server_get_u64(const unsigned char *p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = value << 8 | p[i];
+    }
+    return value;
+}
+
+// Function Prototypes
+int server_run(const char *socket_path, int workers, const LexLimits *limits);
+
+#endif
@@ -0,0 +1,124 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "source.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char empty_source[1] = "";
+
+// Read an entire stream into one heap buffer
+int source_read(SourceBuffer *source, FILE *file) {
+    size_t capacity = 4096;
+    size_t length = 0;
+
+    // Use the stream size as a first guess when the stream is seekable
+    long start = ftell(file);
+    if (start >= 0 && fseek(file, 0, SEEK_END) == 0) {
+        long end = ftell(file);
+        if (end > start) {
+            capacity = (size_t)(end - start) + 1;
+        }
+        fseek(file, start, SEEK_SET);
+    }
+
+    char *data = malloc(capacity);
+    if (!data) {
+        return -1;
+    }
+
+    for (;;) {
+        length += fread(data + length, 1, capacity - length, file);
+        if (length < capacity) {
+            break; // Short read: end of stream or error
+        }
+
+        char *bigger = realloc(data, capacity * 2);
+        if (!bigger) {
+            free(data);
+            return -1;
+        }
+        data = bigger;
+        capacity *= 2;
+    }
+
+    if (ferror(file)) {
+        free(data);
+        return -1;
+    }
+
+    source->data = data;
+    source->length = length;
+    source->mapped = 0;
+    return 0;
+}
+
+// Map a file into memory, falling back to a single read when mapping is not possible
+int source_open(SourceBuffer *source, const char *path) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        if (info.st_size == 0) {
+            close(fd);
+            source->data = empty_source;
+            source->length = 0;
+            source->mapped = 0;
+            return 0;
+        }
+
+        void *map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            posix_madvise(map, (size_t)info.st_size, POSIX_MADV_SEQUENTIAL);
+            close(fd);
+            source->data = map;
+            source->length = (size_t)info.st_size;
+            source->mapped = 1;
+            return 0;
+        }
+    }
+
+    // Pipes, devices and failed mappings are read in one go instead
+    FILE *file = fdopen(fd, "rb");
+    if (!file) {
+        close(fd);
+        return -1;
+    }
+#else
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+#endif
+
+    int status = source_read(source, file);
+    fclose(file);
+    return status;
+}
+
+void source_close(SourceBuffer *source) {
+#ifndef _WIN32
+    if (source->mapped) {
+        munmap((void *)source->data, source->length);
+    } else
+#endif
+    if (source->data != empty_source) {
+        free((void *)source->data);
+    }
+
+    source->data = NULL;
+    source->length = 0;
+    source->mapped = 0;
+}
@@ -0,0 +1,19 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Whole-file input buffer the lexer scans with a plain pointer cursor
+typedef struct {
+    const char *data;   // First byte of the input (not NUL-terminated)
+    size_t length;      // Number of bytes in data
+    int mapped;         // 1 if data is a memory mapping, 0 if heap-allocated
+} SourceBuffer;
+
+// Function Prototypes
+int source_open(SourceBuffer *source, const char *path);
+int source_read(SourceBuffer *source, FILE *file);
+void source_close(SourceBuffer *source);
+
+#endif
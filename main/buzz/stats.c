@@ -0,0 +1,57 @@
+#include "lex.h"
+
+#include <string.h>
+
+void stats_reset(LexStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+// Add the counters of another state, e.g. a parallel chunk, into 'into'
+void stats_merge(LexStats *into, const LexStats *from) {
+    into->bytes += from->bytes;
+    into->lookaheads += from->lookaheads;
+    into->allocations += from->allocations;
+    into->allocated_bytes += from->allocated_bytes;
+    into->keyword_lookups += from->keyword_lookups;
+    into->keyword_hits += from->keyword_hits;
+    into->invalid_bytes += from->invalid_bytes;
+    for (int type = 0; type < END_OF_TOKENS; type++) {
+        into->tokens[type] += from->tokens[type];
+    }
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        into->clock[phase] += from->clock[phase];
+    }
+}
+
+// One JSON object; token types that never occurred are left out
+void stats_write_json(FILE *out, const LexStats *stats) {
+    static const char *phase_names[PHASE_COUNT] = {"read", "classify", "store", "output"};
+    unsigned long long total = 0;
+
+    fprintf(out, "{\"bytes\":%llu,\"lookaheads\":%llu,\"allocations\":%llu,\"allocated_bytes\":%llu,",
+            stats->bytes, stats->lookaheads, stats->allocations, stats->allocated_bytes);
+    fprintf(out, "\"keyword_lookups\":%llu,\"keyword_hits\":%llu,\"invalid_bytes\":%llu,",
+            stats->keyword_lookups, stats->keyword_hits, stats->invalid_bytes);
+
+    fprintf(out, "\"tokens_by_type\":{");
+    for (int type = 0, first = 1; type < END_OF_TOKENS; type++) {
+        if (stats->tokens[type] == 0) {
+            continue;
+        }
+        fprintf(out, "%s\"%s\":%llu", first ? "" : ",", token_name((TokenType)type), stats->tokens[type]);
+        total += stats->tokens[type];
+        first = 0;
+    }
+    fprintf(out, "},\"tokens\":%llu,", total);
+
+    // storeToken runs inside lexNext, so its time is taken out of classify
+    fprintf(out, "\"clock_unit\":\"%s\",\"clock\":{", STATS_CLOCK_UNIT);
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        unsigned long long ticks = stats->clock[phase];
+        if (phase == PHASE_CLASSIFY) {
+            ticks = ticks > stats->clock[PHASE_STORE] ? ticks - stats->clock[PHASE_STORE] : 0;
+        }
+        fprintf(out, "%s\"%s\":%llu", phase ? "," : "", phase_names[phase], ticks);
+    }
+    fprintf(out, "}}\n");
+}
@@ -0,0 +1,67 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Hot-path counters kept in every LexerState when built with -DLEX_STATS.
+// Included by lex.h once TokenType is declared; without LEX_STATS the STAT_
+// macros compile to nothing.
+
+#include <stdio.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define STATS_CLOCK_UNIT "cycles"
+#else
+#include <time.h>
+#define STATS_CLOCK_UNIT "ns"
+#endif
+
+typedef enum {
+    PHASE_READ,         // Opening or reading the input
+    PHASE_CLASSIFY,     // lexNext, not counting storeToken
+    PHASE_STORE,        // storeToken
+    PHASE_OUTPUT,       // Formatting and writing the tokens
+    PHASE_COUNT
+} StatsPhase;
+
+typedef struct {
+    unsigned long long bytes;           // Bytes consumed by lexNext, blanks included
+    unsigned long long lookaheads;      // peekChar calls, the buffer's stand-in for ungetc
+    unsigned long long allocations;     // Token array allocations and regrowths
+    unsigned long long allocated_bytes;
+    unsigned long long keyword_lookups;
+    unsigned long long keyword_hits;
+    unsigned long long invalid_bytes;   // Bytes recovered from as INVALID tokens
+    unsigned long long tokens[END_OF_TOKENS];
+    unsigned long long clock[PHASE_COUNT];
+} LexStats;
+
+// Cheapest timestamp available: the time-stamp counter on x86, otherwise a monotonic clock
+static inline uint64_t stats_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+#ifdef LEX_STATS
+#define STAT_ADD(state, field, n) ((state)->stats.field += (n))
+#define STAT_ALLOC(state, size) ((state)->stats.allocations++, (state)->stats.allocated_bytes += (size))
+#define STAT_START(name) uint64_t name = stats_clock()
+#define STAT_STOP(state, phase, name) ((state)->stats.clock[phase] += stats_clock() - (name))
+#else
+#define STAT_ADD(state, field, n) ((void)0)
+#define STAT_ALLOC(state, size) ((void)0)
+#define STAT_START(name) ((void)0)
+#define STAT_STOP(state, phase, name) ((void)0)
+#endif
+
+// Function Prototypes
+void stats_reset(LexStats *stats);
+void stats_merge(LexStats *into, const LexStats *from);
+void stats_write_json(FILE *out, const LexStats *stats);
+
+#endif
@@ -0,0 +1,123 @@
+#include "symbols.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SYMBOLS_INITIAL_SLOTS 256
+
+void symbols_init(SymbolTable *table) {
+    memset(table, 0, sizeof(*table));
+}
+
+// FNV-1a: identifiers are short, so a byte loop is as fast as anything wider
+static uint32_t symbol_hash(const char *name, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Slot holding 'name', or the empty slot where it would go.
+// The hash kept in the slot rules out almost every other name without touching its Symbol.
+static uint64_t *find_slot(const SymbolTable *table, const char *name, size_t length, uint32_t hash) {
+    for (uint32_t i = hash & table->slot_mask;; i = (i + 1) & table->slot_mask) {
+        uint64_t *slot = &table->slots[i];
+        if (*slot == 0) {
+            return slot;
+        }
+        if ((uint32_t)(*slot >> 32) != hash) {
+            continue;
+        }
+
+        const Symbol *symbol = &table->symbols[(uint32_t)*slot - 1];
+        if (symbol->length == length && memcmp(symbol->name, name, length) == 0) {
+            return slot;
+        }
+    }
+}
+
+static uint64_t slot_value(uint32_t hash, uint32_t id) {
+    return (uint64_t)hash << 32 | (id + 1);
+}
+
+// Double the slots, keeping the table at most half full
+static void grow_slots(SymbolTable *table) {
+    uint32_t slot_count = table->slots ? (table->slot_mask + 1) * 2 : SYMBOLS_INITIAL_SLOTS;
+
+    free(table->slots);
+    table->slots = calloc(slot_count, sizeof(uint64_t));
+    if (!table->slots) {
+        perror("Failed to allocate memory for symbols");
+        exit(EXIT_FAILURE);
+    }
+    table->slot_mask = slot_count - 1;
+
+    for (uint32_t id = 0; id < table->count; id++) {
+        const Symbol *symbol = &table->symbols[id];
+        *find_slot(table, symbol->name, symbol->length, symbol->hash) = slot_value(symbol->hash, id);
+    }
+}
+
+// ID of the identifier spelled 'name', adding it when it is new
+uint32_t symbols_intern(SymbolTable *table, const char *name, size_t length) {
+    if (table->count * 2 >= table->slot_mask) { // Also true before the first slots exist
+        grow_slots(table);
+    }
+
+    uint32_t hash = symbol_hash(name, length);
+    uint64_t *slot = find_slot(table, name, length, hash);
+    if (*slot != 0) {
+        return (uint32_t)*slot - 1;
+    }
+
+    if (table->count == table->capacity) {
+        table->capacity = table->capacity ? table->capacity * 2 : SYMBOLS_INITIAL_SLOTS / 2;
+        Symbol *symbols = realloc(table->symbols, sizeof(Symbol) * table->capacity);
+        if (!symbols) {
+            perror("Failed to allocate memory for symbols");
+            exit(EXIT_FAILURE);
+        }
+        table->symbols = symbols;
+    }
+
+    Symbol *symbol = &table->symbols[table->count];
+    symbol->name = name;
+    symbol->length = (uint32_t)length;
+    symbol->hash = hash;
+    *slot = slot_value(hash, table->count);
+    return table->count++;
+}
+
+// ID of the identifier spelled 'name', SYMBOL_NONE when it never appeared
+uint32_t symbols_find(const SymbolTable *table, const char *name, size_t length) {
+    if (!table->slots) {
+        return SYMBOL_NONE;
+    }
+
+    uint64_t *slot = find_slot(table, name, length, symbol_hash(name, length));
+    return *slot ? (uint32_t)*slot - 1 : SYMBOL_NONE;
+}
+
+// Copy the names of symbols 'first' on into 'arena', so the table outlives the source they were found in
+void symbols_keep_names(SymbolTable *table, uint32_t first, Arena *arena) {
+    for (uint32_t id = first; id < table->count; id++) {
+        Symbol *symbol = &table->symbols[id];
+        symbol->name = arena_strndup(arena, symbol->name, symbol->length);
+    }
+}
+
+// Forget every symbol but keep the memory for the next input
+void symbols_clear(SymbolTable *table) {
+    if (table->slots) {
+        memset(table->slots, 0, sizeof(uint64_t) * (table->slot_mask + 1));
+    }
+    table->count = 0;
+}
+
+void symbols_free(SymbolTable *table) {
+    free(table->symbols);
+    free(table->slots);
+    symbols_init(table);
+}
@@ -0,0 +1,37 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+// No symbol: unknown names, and the TokenTable rows of tokens that are not identifiers
+// (Token.symbol itself is only set for VAR_IDENT and FUNC_IDENT)
+#define SYMBOL_NONE UINT32_MAX
+
+// One distinct identifier spelling ('#' or '~' included); the name points into the source
+typedef struct {
+    const char *name;
+    uint32_t length;
+    uint32_t hash;
+} Symbol;
+
+// Identifiers interned to dense IDs 0, 1, 2, ... in order of first appearance
+typedef struct {
+    Symbol *symbols;        // Indexed by symbol ID
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t *slots;        // Open addressing: hash << 32 | (symbol ID + 1), 0 for an empty slot
+    uint32_t slot_mask;     // Slot count - 1 (a power of two)
+} SymbolTable;
+
+// Function Prototypes
+void symbols_init(SymbolTable *table);
+uint32_t symbols_intern(SymbolTable *table, const char *name, size_t length);
+uint32_t symbols_find(const SymbolTable *table, const char *name, size_t length);
+void symbols_keep_names(SymbolTable *table, uint32_t first, Arena *arena);
+void symbols_clear(SymbolTable *table);
+void symbols_free(SymbolTable *table);
+
+#endif
@@ -0,0 +1,210 @@
+#include "tokenfile.h"
+#include "literal.h"
+#include "lines.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Growable byte buffer for the encoded stream
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+} ByteBuffer;
+
+static void put_varint(ByteBuffer *buffer, uint64_t value) {
+    if (buffer->length + 10 > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+        uint8_t *data = realloc(buffer->data, capacity);
+        if (!data) {
+            perror("Failed to allocate memory for token stream");
+            exit(EXIT_FAILURE);
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+
+    while (value >= 0x80) {
+        buffer->data[buffer->length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer->data[buffer->length++] = (uint8_t)value;
+}
+
+static void put_u16(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static void put_u64(uint8_t *p, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+// Write 'count' tokens lexed from 'source' as a binary token file; -1 on a write error
+int token_file_write(FILE *out, const char *source, const Token *tokens, size_t count) {
+    ByteBuffer stream = {0};
+    uint64_t strings_size = 0;
+    size_t previous_end = 0;
+    unsigned int previous_line = 0, previous_column = 0;
+    unsigned int line, column;
+
+    // Tokens only carry offsets; the file keeps their positions for readers without the source
+    LineCursor cursor;
+    line_cursor_init(&cursor, source);
+
+    for (size_t i = 0; i < count; i++) {
+        const Token *token = &tokens[i];
+        line_cursor_seek(&cursor, token->offset, &line, &column);
+
+        put_varint(&stream, (uint64_t)token->type);
+        put_varint(&stream, token->offset - previous_end);
+        if (!token_spelling(token->type)) {
+            put_varint(&stream, token->length);
+            strings_size += token->length;
+        }
+        put_varint(&stream, line - previous_line);
+        put_varint(&stream, line == previous_line ? column - previous_column : column);
+
+        previous_end = token->offset + token->length;
+        previous_line = line;
+        previous_column = column;
+    }
+
+    uint8_t header[TOKEN_FILE_HEADER] = {0};
+    memcpy(header, TOKEN_FILE_MAGIC, 4);
+    put_u16(header + 4, TOKEN_FILE_VERSION);
+    put_u16(header + 6, TOKEN_FILE_HEADER);
+    put_u64(header + 8, count);
+    put_u64(header + 16, strings_size);
+    put_u64(header + 24, stream.length);
+
+    int status = fwrite(header, 1, sizeof(header), out) == sizeof(header) ? 0 : -1;
+    for (size_t i = 0; i < count && status == 0; i++) {
+        if (!token_spelling(tokens[i].type) && tokens[i].length > 0 &&
+            fwrite(source + tokens[i].offset, 1, tokens[i].length, out) != tokens[i].length) {
+            status = -1;
+        }
+    }
+    if (status == 0 && stream.length > 0 && fwrite(stream.data, 1, stream.length, out) != stream.length) {
+        status = -1;
+    }
+
+    free(stream.data);
+    return status;
+}
+
+// Map a token file and check its header; -1 if it cannot be read or is not a version 1 token file
+int token_reader_open(TokenReader *reader, const char *path) {
+    if (source_open(&reader->file, path) != 0) {
+        return -1;
+    }
+
+    const uint8_t *data = (const uint8_t *)reader->file.data;
+    size_t length = reader->file.length;
+
+    if (length < TOKEN_FILE_HEADER || memcmp(data, TOKEN_FILE_MAGIC, 4) != 0 ||
+        (data[4] | data[5] << 8) != TOKEN_FILE_VERSION) {
+        source_close(&reader->file);
+        return -1;
+    }
+
+    size_t header_size = data[6] | data[7] << 8;
+    uint64_t strings_size = get_u64(data + 16);
+    uint64_t stream_size = get_u64(data + 24);
+    if (header_size < TOKEN_FILE_HEADER || header_size > length ||
+        strings_size > length - header_size || stream_size > length - header_size - strings_size) {
+        source_close(&reader->file);
+        return -1;
+    }
+
+    reader->count = get_u64(data + 8);
+    reader->index = 0;
+    reader->strings = (const char *)data + header_size;
+    reader->strings_end = reader->strings + strings_size;
+    reader->stream = data + header_size + strings_size;
+    reader->stream_end = reader->stream + stream_size;
+    memset(&reader->previous, 0, sizeof(reader->previous));
+    reader->line = 0;
+    reader->column = 0;
+    return 0;
+}
+
+static int get_varint(TokenReader *reader, uint64_t *value) {
+    uint64_t result = 0;
+
+    for (int shift = 0; shift < 64 && reader->stream < reader->stream_end; shift += 7) {
+        uint8_t byte = *reader->stream++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/* Decode the next token and point 'text' at its spelling (token->length
+   bytes, not NUL-terminated); its line and column are left in the reader.
+   Returns 1 for a token, 0 at the end, -1 if the file is damaged. */
+int token_reader_next(TokenReader *reader, Token *token, const char **text) {
+    if (reader->index == reader->count) {
+        return 0;
+    }
+
+    uint64_t type, gap, length = 0, line_delta, column;
+    if (get_varint(reader, &type) != 0 || type >= END_OF_TOKENS || get_varint(reader, &gap) != 0) {
+        return -1;
+    }
+
+    const char *spelling = token_spelling((TokenType)type);
+    if (spelling) {
+        length = strlen(spelling);
+        *text = spelling;
+    } else {
+        if (get_varint(reader, &length) != 0 || length > LEX_MAX_LENGTH ||
+            length > (uint64_t)(reader->strings_end - reader->strings)) {
+            return -1;
+        }
+        *text = reader->strings;
+        reader->strings += length;
+    }
+
+    if (get_varint(reader, &line_delta) != 0 || get_varint(reader, &column) != 0) {
+        return -1;
+    }
+
+    const Token *previous = &reader->previous;
+    token->type = (TokenType)type;
+    token->offset = previous->offset + previous->length + gap;
+    token->length = (unsigned int)length;
+    reader->column = line_delta == 0 ? reader->column + (unsigned int)column : (unsigned int)column;
+    reader->line += (unsigned int)line_delta;
+    // Values are not stored: literals are decoded again, symbol IDs are assigned by lexer_append
+    token->integer = 0;
+    if (type == INTEGER && literal_integer(*text, length, &token->integer) != 0) {
+        return -1;
+    }
+    if (type == FLOAT && literal_float(*text, length, &token->real) != 0) {
+        return -1;
+    }
+
+    reader->previous = *token;
+    reader->index++;
+    return 1;
+}
+
+void token_reader_close(TokenReader *reader) {
+    source_close(&reader->file);
+}
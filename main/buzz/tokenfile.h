@@ -0,0 +1,48 @@
+#ifndef TOKENFILE_H
+#define TOKENFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "lex.h"
+#include "source.h"
+
+/* Binary token file (.bzt), all integers little-endian:
+
+   header   "BZTK", u16 version, u16 header size,
+            u64 token count, u64 string table size, u64 stream size
+   strings  spellings of every token whose type has no fixed spelling
+            (literals, identifiers, comments, invalid), back to back in token order
+   stream   per token, as unsigned LEB128 varints:
+              type
+              offset - end of the previous token
+              length               (only when the type has no fixed spelling)
+              line - previous line
+              column - previous column on the same line, otherwise the column itself */
+
+#define TOKEN_FILE_MAGIC "BZTK"
+#define TOKEN_FILE_VERSION 1
+#define TOKEN_FILE_HEADER 32
+#define TOKEN_FILE_EXTENSION ".bzt"
+
+// Reads a token file mapped into memory
+typedef struct {
+    SourceBuffer file;
+    uint64_t count;             // Tokens in the file
+    uint64_t index;             // Tokens read so far
+    const char *strings;        // Next spelling in the string table
+    const char *strings_end;
+    const uint8_t *stream;      // Next encoded token
+    const uint8_t *stream_end;
+    Token previous;
+    unsigned int line;          // Position of the last token read, as stored by the writer
+    unsigned int column;
+} TokenReader;
+
+// Function Prototypes
+int token_file_write(FILE *out, const char *source, const Token *tokens, size_t count);
+int token_reader_open(TokenReader *reader, const char *path);
+int token_reader_next(TokenReader *reader, Token *token, const char **text);
+void token_reader_close(TokenReader *reader);
+
+#endif
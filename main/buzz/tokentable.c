@@ -0,0 +1,137 @@
+#include "tokentable.h"
+#include "lines.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TABLE_INITIAL 1024
+
+void token_table_init(TokenTable *table, int flags) {
+    memset(table, 0, sizeof(*table));
+    table->flags = flags;
+}
+
+static void *grow_array(void *array, size_t element, size_t capacity) {
+    void *grown = realloc(array, element * capacity);
+    if (!grown) {
+        perror("Failed to allocate memory for token table");
+        exit(EXIT_FAILURE);
+    }
+    return grown;
+}
+
+static void reserve(TokenTable *table, size_t needed) {
+    if (needed <= table->capacity) {
+        return;
+    }
+
+    size_t capacity = table->capacity ? table->capacity * 2 : TABLE_INITIAL;
+    if (capacity < needed) {
+        capacity = needed;
+    }
+
+    table->types = grow_array(table->types, sizeof(uint8_t), capacity);
+    table->offsets = grow_array(table->offsets, sizeof(uint32_t), capacity);
+    table->lengths = grow_array(table->lengths, sizeof(uint32_t), capacity);
+    if (table->flags & TOKEN_TABLE_LINES) {
+        table->lines = grow_array(table->lines, sizeof(uint32_t), capacity);
+        table->columns = grow_array(table->columns, sizeof(uint32_t), capacity);
+    }
+    if (table->flags & TOKEN_TABLE_SYMBOLS) {
+        table->symbols = grow_array(table->symbols, sizeof(uint32_t), capacity);
+    }
+    table->capacity = capacity;
+}
+
+// Add one token (its line and column stay 0 until token_table_lex fills them); -1 when its offset does not fit the 32-bit columns
+int token_table_append(TokenTable *table, const Token *token) {
+    if (token->offset > UINT32_MAX) {
+        return -1;
+    }
+
+    reserve(table, table->count + 1);
+
+    size_t i = table->count++;
+    table->types[i] = (uint8_t)token->type;
+    table->offsets[i] = (uint32_t)token->offset;
+    table->lengths[i] = token->length;
+    if (table->flags & TOKEN_TABLE_LINES) {
+        table->lines[i] = 0;
+        table->columns[i] = 0;
+    }
+    if (table->flags & TOKEN_TABLE_SYMBOLS) {
+        table->symbols[i] = token->type == VAR_IDENT || token->type == FUNC_IDENT ? token->symbol : SYMBOL_NONE;
+    }
+    return 0;
+}
+
+// Lex a whole buffer straight into the table (release the state with lexer_free); -1 if the input is too large for it
+int token_table_lex(TokenTable *table, LexerState *state, const char *source, size_t length) {
+    Token token;
+
+    if (length > UINT32_MAX) {
+        return -1;
+    }
+
+    size_t first = table->count;
+    lexer_init(state, source, length);
+    reserve(table, table->count + LEX_PREDICT_TOKENS(length));
+    while (lexer_next(state, &token)) {
+        token_table_append(table, &token);
+    }
+
+    // Positions in a second pass, one forward walk over the offsets
+    if (table->flags & TOKEN_TABLE_LINES) {
+        LineCursor cursor;
+        unsigned int line, column;
+        line_cursor_init(&cursor, source);
+        for (size_t i = first; i < table->count; i++) {
+            line_cursor_seek(&cursor, table->offsets[i], &line, &column);
+            table->lines[i] = line;
+            table->columns[i] = column;
+        }
+    }
+    return 0;
+}
+
+size_t token_table_count(const TokenTable *table, TokenType type) {
+    const uint8_t *types = table->types;
+    size_t count = 0;
+
+    for (size_t i = 0; i < table->count; i++) {
+        count += types[i] == type;
+    }
+    return count;
+}
+
+// Number of tokens of every type, in one pass over the types
+void token_table_histogram(const TokenTable *table, size_t counts[END_OF_TOKENS]) {
+    memset(counts, 0, sizeof(size_t) * END_OF_TOKENS);
+    for (size_t i = 0; i < table->count; i++) {
+        counts[table->types[i]]++;
+    }
+}
+
+// Write the index of every token of 'type' to 'indices' (room for token_table_count entries); returns how many
+size_t token_table_filter(const TokenTable *table, TokenType type, size_t *indices) {
+    const uint8_t *types = table->types;
+    size_t found = 0;
+
+    for (size_t i = 0; i < table->count; i++) {
+        if (types[i] == type) {
+            indices[found++] = i;
+        }
+    }
+    return found;
+}
+
+void token_table_free(TokenTable *table) {
+    free(table->types);
+    free(table->offsets);
+    free(table->lengths);
+    free(table->lines);
+    free(table->columns);
+    free(table->symbols);
+    token_table_init(table, table->flags);
+}
@@ -0,0 +1,36 @@
+#ifndef TOKENTABLE_H
+#define TOKENTABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lex.h"
+
+// Also keep line and column of every token (filled in by token_table_lex)
+#define TOKEN_TABLE_LINES 0x01
+// Also keep the symbol ID of every token (names from lexer_symbols of the lexing state)
+#define TOKEN_TABLE_SYMBOLS 0x02
+
+// Tokens as parallel arrays, so a pass over types touches one byte per token
+typedef struct {
+    uint8_t *types;         // TokenType of every token
+    uint32_t *offsets;      // Byte offset into the source
+    uint32_t *lengths;      // Length of the spelling
+    uint32_t *lines;        // NULL unless TOKEN_TABLE_LINES
+    uint32_t *columns;      // NULL unless TOKEN_TABLE_LINES
+    uint32_t *symbols;      // NULL unless TOKEN_TABLE_SYMBOLS; SYMBOL_NONE for tokens that are not identifiers
+    size_t count;
+    size_t capacity;
+    int flags;
+} TokenTable;
+
+// Function Prototypes
+void token_table_init(TokenTable *table, int flags);
+int token_table_append(TokenTable *table, const Token *token);
+int token_table_lex(TokenTable *table, LexerState *state, const char *source, size_t length);
+size_t token_table_count(const TokenTable *table, TokenType type);
+void token_table_histogram(const TokenTable *table, size_t counts[END_OF_TOKENS]);
+size_t token_table_filter(const TokenTable *table, TokenType type, size_t *indices);
+void token_table_free(TokenTable *table);
+
+#endif
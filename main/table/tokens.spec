@@ -0,0 +1,76 @@
+// Buzz tokens, read by tools/dfa_gen to generate buzz/dfa_table.h (see readme.md).
+//
+// name = pattern       a named fragment, used in later patterns as {name}
+// pattern  ACTION...   a rule; each ACTION is a TokenType, TYPE/n for a fixed n-byte
+//                      part of a token that is split, or SKIP
+// @keywords            a literal rule for every word in buzz/keywords.def
+//
+// Patterns: literal bytes, \n \t \v \f \r \xHH and \<punctuation> escapes, . for any
+// byte, [classes] with ranges, ^ and {name}, ( ) grouping, | * + ?. A pattern ends
+// at the first blank outside [ ]. The longest match wins; between rules matching
+// the same length, the one listed first. Some rule has to match every prefix of a
+// repeated part (the catch-all at the end takes care of single bytes); dfa_gen
+// rejects a spec where input could run on unmatched, as lex_dfa would rescan it.
+
+space = [ \t\n\v\f\r]
+alpha = [A-Za-z]
+digit = [0-9]
+word = [A-Za-z0-9_]
+
+{space}+                            SKIP
+
+// Block comments, split into begin, body and end; an unclosed one runs to the end of the file
+<\|([^:]|:+[^:>])*:*:>              COMMENT_BEGIN/2 COMMENT COMMENT_END/2
+<\|([^:]|:+[^:>])*:*                COMMENT_BEGIN/2 COMMENT
+
+// Identifiers; a sigil without a letter after it swallows everything up to the next blank
+#{alpha}{word}*                     VAR_IDENT
+~{alpha}{word}*                     FUNC_IDENT
+[#~]([^{alpha}{space}][^{space}]*)? INVALID
+
+// Numbers; a second decimal point makes the whole run invalid
+{digit}+                            INTEGER
+{digit}+\.{digit}*                  FLOAT
+{digit}+\.{digit}*\.[0-9.]*         INVALID
+
+// Words: keywords, the returnvalue noise word, and letters running into digits take the rest of the line
+@keywords
+returnvalue                         RETURN_TOKEN/6 NOISE_WORD/5
+{alpha}+                            INVALID
+{alpha}+{digit}[^\n]*               INVALID
+
+// Operators
+\+                                  ADDITION
+\+\+                                INCREMENT
+-                                   SUBTRACTION
+--                                  DECREMENT
+\*                                  MULTIPLICATION
+/                                   DIVISION
+\/\/                                INT_DIVISION
+%                                   MODULO
+\^                                  EXPONENT
+=                                   ASSIGNMENT_OP
+==                                  IS_EQUAL_TO
+>                                   GREATER_THAN
+>=                                  GREATER_EQUAL
+<                                   LESS_THAN
+<=                                  LESS_EQUAL
+!                                   NOT
+!=                                  NOT_EQUAL
+&&                                  AND
+\|\|                                OR
+
+// Delimiters
+;                                   SEMICOLON
+,                                   COMMA
+\(                                  LEFT_PAREN
+\)                                  RIGHT_PAREN
+\[                                  LEFT_BRACKET
+\]                                  RIGHT_BRACKET
+\{                                  LEFT_BRACE
+\}                                  RIGHT_BRACE
+"                                   DBL_QUOTE
+'                                   SNGL_QUOTE
+
+// Any other byte on its own
+.                                   INVALID
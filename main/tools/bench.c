@@ -0,0 +1,372 @@
+// Times every lexer engine on the given .bz files and prints one JSON object per file and engine.
+// Each engine runs in its own process, so peak RSS is that engine's alone (input included).
+// The lex_edit row times single edits instead of whole files: its seconds should not grow with the file.
+// Link with --wrap to also count heap allocations per token:
+//
+// gcc -O2 -pthread -DBENCH_COUNT_ALLOCS -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc tools/bench.c buzz/lex.c buzz/symbols.c buzz/literal.c buzz/source.c buzz/parallel.c buzz/arena.c buzz/scan.c buzz/charclass.c buzz/lines.c buzz/tokentable.c buzz/dfa.c buzz/incremental.c -o bench.exe
+// bench.exe --runs 5 --label "$(git rev-parse --short HEAD)" bench.bz >> bench.jsonl
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "../buzz/lex.h"
+#include "../buzz/source.h"
+#include "../buzz/tokentable.h"
+#include "../buzz/dfa.h"
+#include "../buzz/incremental.h"
+
+#ifdef BENCH_COUNT_ALLOCS
+#include <stdatomic.h>
+
+// Every malloc, calloc and realloc in the process, lexer threads included
+static atomic_ullong allocation_count;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __real_realloc(pointer, size);
+}
+
+#define ALLOCATIONS() atomic_load(&allocation_count)
+#else
+#define ALLOCATIONS() 0ULL
+#endif
+
+// One way of turning a file into tokens; returns the token count or -1
+typedef long long (*Engine)(const char *path, const SourceBuffer *source);
+
+static long long run_lex(const char *path, const SourceBuffer *source) {
+    (void)source;
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+
+    LexerState state;
+    size_t count = 0;
+    Token *tokens = lex(&state, file, &count);
+    fclose(file);
+    if (!tokens) {
+        return -1;
+    }
+    lexer_free(&state);
+    return (long long)count;
+}
+
+static long long run_lex_buffer(const char *path, const SourceBuffer *source) {
+    (void)path;
+    LexerState state;
+    size_t count = 0;
+    lex_buffer(&state, source->data, source->length, &count);
+    lexer_free(&state);
+    return (long long)count;
+}
+
+static long long run_lex_parallel(const char *path, const SourceBuffer *source) {
+    (void)path;
+    LexerState state;
+    size_t count = 0;
+    if (!lex_parallel(&state, source->data, source->length, 0, &count)) {
+        return -1;
+    }
+    lexer_free(&state);
+    return (long long)count;
+}
+
+static long long run_lexer_next(const char *path, const SourceBuffer *source) {
+    (void)path;
+    LexerState state;
+    Token token;
+    long long count = 0;
+
+    lexer_init(&state, source->data, source->length);
+    while (lexer_next(&state, &token)) {
+        count++;
+    }
+    lexer_free(&state);
+    return count;
+}
+
+static long long run_token_table(const char *path, const SourceBuffer *source) {
+    (void)path;
+    LexerState state;
+    TokenTable table;
+
+    token_table_init(&table, 0);
+    if (token_table_lex(&table, &state, source->data, source->length) != 0) {
+        token_table_free(&table);
+        return -1;
+    }
+    long long count = (long long)table.count;
+    token_table_free(&table);
+    return count;
+}
+
+static long long run_lex_dfa(const char *path, const SourceBuffer *source) {
+    (void)path;
+    LexerState state;
+    size_t count = 0;
+    lex_dfa(&state, source->data, source->length, &count);
+    lexer_free(&state);
+    return (long long)count;
+}
+
+static const struct {
+    const char *name;
+    Engine run;
+} engines[] = {
+    {"lex", run_lex},
+    {"lex_buffer", run_lex_buffer},
+    {"lex_parallel", run_lex_parallel},
+    {"lexer_next", run_lexer_next},
+    {"token_table", run_token_table},
+    {"lex_dfa", run_lex_dfa},
+    {"lex_edit", NULL}, // Timed per edit by bench_edits
+};
+
+#define ENGINE_COUNT (sizeof(engines) / sizeof(engines[0]))
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Print a string as a JSON string literal
+static void put_json_string(const char *text) {
+    putchar('"');
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\') {
+            putchar('\\');
+        }
+        if ((unsigned char)*text >= 0x20) {
+            putchar(*text);
+        }
+    }
+    putchar('"');
+}
+
+static int compare_seconds(const void *a, const void *b) {
+    double left = *(const double *)a, right = *(const double *)b;
+    return (left > right) - (left < right);
+}
+
+#define BENCH_EDITS 200 // Offsets edited per run of the lex_edit row
+
+/* Edit latency: lex the file into a document once, then insert a space at
+   BENCH_EDITS offsets spread over it, deleting each again. 'seconds' is
+   the median of those edits and 'max_seconds' the slowest, which includes
+   the occasional compaction of the document's runs. */
+static int bench_edits(const char *path, int runs, const char *label) {
+    SourceBuffer source;
+    if (source_open(&source, path) != 0) {
+        fprintf(stderr, "Error: Unable to open file '%s'.\n", path);
+        return EXIT_FAILURE;
+    }
+
+    size_t length = source.length;
+    size_t samples = (size_t)runs * BENCH_EDITS * 2;
+    char *spaced = malloc(length + 1);
+    double *seconds = malloc(sizeof(double) * samples);
+    if (!spaced || !seconds) {
+        perror("Failed to allocate memory for edits");
+        return EXIT_FAILURE;
+    }
+
+    LexDocument document;
+    size_t taken = 0;
+    unsigned long long relexed = 0;
+    lex_document_open(&document, source.data, length);
+
+    for (int run = 0; run < runs; run++) {
+        // 'spaced' is the source with a space at 'at'; moving the space only copies the bytes it passes
+        size_t at = 0;
+        spaced[0] = ' ';
+        memcpy(spaced + 1, source.data, length);
+
+        for (size_t i = 0; i < BENCH_EDITS; i++) {
+            size_t next = (size_t)((i + 0.5) * length / BENCH_EDITS);
+            memcpy(spaced + at, source.data + at, next - at);
+            spaced[next] = ' ';
+            at = next;
+
+            LexEdit insert = {at, 0, 1};
+            LexEdit erase = {at, 1, 0};
+            double start = now_seconds();
+            lex_edit(&document, spaced, length + 1, &insert);
+            seconds[taken++] = now_seconds() - start;
+            relexed += document.changed_count;
+
+            start = now_seconds();
+            lex_edit(&document, source.data, length, &erase);
+            seconds[taken++] = now_seconds() - start;
+            relexed += document.changed_count;
+        }
+    }
+
+    qsort(seconds, taken, sizeof(double), compare_seconds);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    long peak_kb = usage.ru_maxrss / 1024;
+#else
+    long peak_kb = usage.ru_maxrss;
+#endif
+
+    printf("{\"label\":");
+    put_json_string(label);
+    printf(",\"file\":");
+    put_json_string(path);
+    printf(",\"engine\":\"lex_edit\",\"bytes\":%zu,\"tokens\":%zu,\"edits\":%zu,\"seconds\":%.9f,\"max_seconds\":%.9f",
+           length, document.count, taken, seconds[taken / 2], seconds[taken - 1]);
+    printf(",\"relexed_per_edit\":%.1f,\"peak_rss_kb\":%ld}\n", (double)relexed / taken, peak_kb);
+
+    lex_document_free(&document);
+    free(seconds);
+    free(spaced);
+    source_close(&source);
+    return EXIT_SUCCESS;
+}
+
+// Runs in a child process: time 'runs' passes of one engine and print the result line
+static int bench_engine(size_t engine, const char *path, int runs, const char *label) {
+    if (!engines[engine].run) {
+        return bench_edits(path, runs, label);
+    }
+
+    SourceBuffer source;
+    if (source_open(&source, path) != 0) {
+        fprintf(stderr, "Error: Unable to open file '%s'.\n", path);
+        return EXIT_FAILURE;
+    }
+
+    double best = 0;
+    long long tokens = 0;
+    unsigned long long allocations = 0;
+
+    for (int run = 0; run < runs; run++) {
+        unsigned long long before = ALLOCATIONS();
+        double start = now_seconds();
+        tokens = engines[engine].run(path, &source);
+        double elapsed = now_seconds() - start;
+        allocations = ALLOCATIONS() - before;
+
+        if (tokens < 0) {
+            fprintf(stderr, "Error: %s failed on '%s'.\n", engines[engine].name, path);
+            source_close(&source);
+            return EXIT_FAILURE;
+        }
+        if (run == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    long peak_kb = usage.ru_maxrss / 1024; // Bytes on macOS, kilobytes elsewhere
+#else
+    long peak_kb = usage.ru_maxrss;
+#endif
+
+    printf("{\"label\":");
+    put_json_string(label);
+    printf(",\"file\":");
+    put_json_string(path);
+    printf(",\"engine\":\"%s\",\"bytes\":%zu,\"tokens\":%lld,\"runs\":%d,\"seconds\":%.6f",
+           engines[engine].name, source.length, tokens, runs, best);
+    printf(",\"mb_per_s\":%.2f,\"tokens_per_s\":%.0f",
+           best > 0 ? source.length / best / 1e6 : 0.0, best > 0 ? tokens / best : 0.0);
+#ifdef BENCH_COUNT_ALLOCS
+    printf(",\"allocations\":%llu,\"allocs_per_token\":%.6f",
+           allocations, tokens > 0 ? (double)allocations / tokens : 0.0);
+#else
+    (void)allocations;
+    printf(",\"allocations\":null,\"allocs_per_token\":null");
+#endif
+    printf(",\"peak_rss_kb\":%ld}\n", peak_kb);
+
+    source_close(&source);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    int runs = 5;
+    const char *label = "";
+    const char *only = NULL;
+    int arg = 1;
+
+    while (arg + 1 < argc && strncmp(argv[arg], "--", 2) == 0) {
+        if (strcmp(argv[arg], "--runs") == 0) {
+            runs = atoi(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--label") == 0) {
+            label = argv[arg + 1];
+        } else if (strcmp(argv[arg], "--engine") == 0) {
+            only = argv[arg + 1];
+        } else {
+            runs = 0; // Unknown option
+            break;
+        }
+        arg += 2;
+    }
+
+    if (arg >= argc || runs < 1) {
+        fprintf(stderr, "Usage: %s [--runs <n>] [--label <text>] [--engine <name>] <input.bz>...\n", argv[0]);
+        fprintf(stderr, "Engines:");
+        for (size_t i = 0; i < ENGINE_COUNT; i++) {
+            fprintf(stderr, " %s", engines[i].name);
+        }
+        fprintf(stderr, "\n");
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    for (; arg < argc; arg++) {
+        for (size_t i = 0; i < ENGINE_COUNT; i++) {
+            if (only && strcmp(only, engines[i].name) != 0) {
+                continue;
+            }
+
+            fflush(stdout);
+            pid_t child = fork();
+            if (child < 0) {
+                perror("Failed to start benchmark process");
+                return EXIT_FAILURE;
+            }
+            if (child == 0) {
+                int result = bench_engine(i, argv[arg], runs, label);
+                fflush(stdout);
+                _exit(result);
+            }
+
+            int child_status;
+            if (waitpid(child, &child_status, 0) < 0 || !WIFEXITED(child_status) ||
+                WEXITSTATUS(child_status) != EXIT_SUCCESS) {
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+
+    return status;
+}
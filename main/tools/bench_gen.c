@@ -0,0 +1,238 @@
+// Writes a synthetic .bz file of a given size for benchmarking the lexer.
+// The token mix is given as weights; the same seed always gives the same file.
+// --names draws identifiers from a fixed pool, as real code repeats its names.
+//
+// gcc tools/bench_gen.c -o bench_gen.exe && bench_gen.exe --names 5000 --mix ident:40,keyword:20,number:15,operator:15,comment:5,invalid:5 16M bench.bz
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    PIECE_IDENT,
+    PIECE_KEYWORD,
+    PIECE_NUMBER,
+    PIECE_OPERATOR,
+    PIECE_COMMENT,
+    PIECE_INVALID,
+    PIECE_COUNT
+} PieceKind;
+
+static const char *piece_names[PIECE_COUNT] = {"ident", "keyword", "number", "operator", "comment", "invalid"};
+
+static const char *keywords[] = {
+#define KEYWORD(type, spelling) spelling,
+#include "../buzz/keywords.def"
+};
+
+static const char *operators[] = {
+    ";", ",", "(", ")", "[", "]", "{", "}", "+", "++", "-", "--", "*", "/", "%", "^",
+    ">", ">=", "<", "<=", "=", "==", "!=", "&&", "||", "!"
+};
+
+static const char *invalid_runs[] = {"abc1", "$", "@@", "1x", "~1", "#", "`", "\\", "?!?"};
+
+#define COUNT_OF(array) (sizeof(array) / sizeof(array[0]))
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+// xorshift64*: fast, and identical output on every platform
+static unsigned int next_random(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (unsigned int)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static unsigned int random_below(unsigned int bound) {
+    return next_random() % bound;
+}
+
+#define NAME_MAX_LENGTH 12
+
+// Identifier pool for --names; empty means every identifier is made up on the spot
+static char (*names)[NAME_MAX_LENGTH + 1];
+static unsigned int name_count;
+
+static void make_word(char *word, int min, int max) {
+    static const char first[] = "abcdefghijklmnopqrstuvwxyz";
+    static const char rest[] = "abcdefghijklmnopqrstuvwxyz0123456789_";
+    int length = min + (int)random_below((unsigned int)(max - min + 1));
+
+    word[0] = first[random_below(sizeof(first) - 1)];
+    for (int i = 1; i < length; i++) {
+        word[i] = rest[random_below(sizeof(rest) - 1)];
+    }
+    word[length] = '\0';
+}
+
+static void put_word(FILE *out, int min, int max) {
+    char word[NAME_MAX_LENGTH + 1];
+    make_word(word, min, max);
+    fputs(word, out);
+}
+
+static void put_piece(FILE *out, PieceKind kind) {
+    switch (kind) {
+        case PIECE_IDENT:
+            fputc(random_below(4) == 0 ? '~' : '#', out);
+            if (name_count > 0) {
+                fputs(names[random_below(name_count)], out);
+            } else {
+                put_word(out, 1, NAME_MAX_LENGTH);
+            }
+            break;
+
+        case PIECE_KEYWORD:
+            fputs(keywords[random_below(COUNT_OF(keywords))], out);
+            break;
+
+        case PIECE_NUMBER:
+            fprintf(out, "%u", random_below(100000000));
+            if (random_below(3) == 0) {
+                fprintf(out, ".%u", random_below(1000));
+            }
+            break;
+
+        case PIECE_OPERATOR:
+            fputs(operators[random_below(COUNT_OF(operators))], out);
+            break;
+
+        case PIECE_COMMENT: {
+            // Long block comments spanning several lines
+            int words = 8 + (int)random_below(120);
+            fputs("<| ", out);
+            for (int i = 0; i < words; i++) {
+                put_word(out, 1, 10);
+                fputc(random_below(10) == 0 ? '\n' : ' ', out);
+            }
+            fputs(":>", out);
+            break;
+        }
+
+        case PIECE_INVALID:
+            fputs(invalid_runs[random_below(COUNT_OF(invalid_runs))], out);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// "ident:40,keyword:20,..." into weights; kinds left out get weight 0
+static int parse_mix(const char *text, unsigned int weights[PIECE_COUNT]) {
+    memset(weights, 0, sizeof(unsigned int) * PIECE_COUNT);
+
+    while (*text) {
+        size_t name_length = strcspn(text, ":");
+        int kind = -1;
+        for (int i = 0; i < PIECE_COUNT; i++) {
+            if (strlen(piece_names[i]) == name_length && strncmp(text, piece_names[i], name_length) == 0) {
+                kind = i;
+            }
+        }
+        if (kind < 0 || text[name_length] != ':') {
+            return -1;
+        }
+
+        char *end;
+        weights[kind] = (unsigned int)strtoul(text + name_length + 1, &end, 10);
+        if (*end != ',' && *end != '\0') {
+            return -1;
+        }
+        text = *end ? end + 1 : end;
+    }
+
+    return 0;
+}
+
+// "4096", "64K" or "16M"
+static long long parse_size(const char *text) {
+    char *end;
+    long long size = strtoll(text, &end, 10);
+
+    if (*end == 'K' || *end == 'k') {
+        size <<= 10, end++;
+    } else if (*end == 'M' || *end == 'm') {
+        size <<= 20, end++;
+    } else if (*end == 'G' || *end == 'g') {
+        size <<= 30, end++;
+    }
+    return *end == '\0' ? size : -1;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned int weights[PIECE_COUNT] = {40, 20, 15, 15, 5, 5};
+    int arg = 1;
+
+    while (arg + 1 < argc && strncmp(argv[arg], "--", 2) == 0) {
+        if (strcmp(argv[arg], "--seed") == 0) {
+            rng_state ^= strtoull(argv[arg + 1], NULL, 10) * 0xBF58476D1CE4E5B9ULL;
+            if (rng_state == 0) {
+                rng_state = 1;
+            }
+        } else if (strcmp(argv[arg], "--names") == 0) {
+            name_count = (unsigned int)strtoul(argv[arg + 1], NULL, 10);
+        } else if (strcmp(argv[arg], "--mix") != 0 || parse_mix(argv[arg + 1], weights) != 0) {
+            arg = argc; // Unknown option or bad mix
+            break;
+        }
+        arg += 2;
+    }
+
+    unsigned int total = 0;
+    for (int i = 0; i < PIECE_COUNT; i++) {
+        total += weights[i];
+    }
+
+    long long size = argc - arg == 2 ? parse_size(argv[arg]) : -1;
+    if (size < 0 || total == 0) {
+        fprintf(stderr, "Usage: %s [--seed <n>] [--names <n>] [--mix ident:40,keyword:20,number:15,operator:15,comment:5,invalid:5] <size[K|M|G]> <output.bz>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (name_count > 0) {
+        names = malloc(sizeof(*names) * name_count);
+        if (!names) {
+            perror("Failed to allocate memory for names");
+            return EXIT_FAILURE;
+        }
+        for (unsigned int i = 0; i < name_count; i++) {
+            make_word(names[i], 1, NAME_MAX_LENGTH);
+        }
+    }
+
+    FILE *out = fopen(argv[arg + 1], "wb");
+    if (!out) {
+        fprintf(stderr, "Error: Unable to create file '%s'.\n", argv[arg + 1]);
+        return EXIT_FAILURE;
+    }
+
+    // Statements of a few tokens, one per line, nested a little
+    int column_tokens = 0;
+    while (ftell(out) < size) {
+        unsigned int pick = random_below(total);
+        int kind = 0;
+        while (pick >= weights[kind]) {
+            pick -= weights[kind++];
+        }
+
+        put_piece(out, (PieceKind)kind);
+
+        if (++column_tokens >= 4 + (int)random_below(8)) {
+            fputc('\n', out);
+            for (unsigned int depth = random_below(4); depth > 0; depth--) {
+                fputs("    ", out);
+            }
+            column_tokens = 0;
+        } else {
+            fputc(' ', out);
+        }
+    }
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Error: Unable to write file '%s'.\n", argv[arg + 1]);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
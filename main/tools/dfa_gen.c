@@ -0,0 +1,858 @@
+// Builds buzz/dfa_table.h from table/tokens.spec and buzz/keywords.def.
+// Every rule becomes part of one NFA (Thompson construction), which is turned
+// into a DFA by subset construction and minimized by partition refinement.
+// Bytes that no pattern tells apart share one column of the transition table.
+// Specs that could make lex_dfa rescan unbounded input after a match are rejected.
+//
+// gcc tools/dfa_gen.c -o dfa_gen.exe && dfa_gen.exe table/tokens.spec buzz/dfa_table.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAX_LINE 1024
+#define MAX_PARTS 3     // Keep in step with DFA_MAX_PARTS in buzz/dfa.c
+
+typedef struct {
+    const char *type;
+    const char *spelling;
+} Word;
+
+static const Word words[] = {
+#define KEYWORD(type, spelling) {#type, spelling},
+#include "../buzz/keywords.def"
+};
+
+#define WORD_COUNT (sizeof(words) / sizeof(words[0]))
+
+typedef struct {
+    unsigned char bits[32];
+} ByteSet;
+
+typedef struct {
+    int epsilon[2];     // Up to two empty edges, -1 when unused
+    int next;           // Target of the byte edge, -1 when there is none
+    int set;            // Bytes of the byte edge, index into sets
+    int accept;         // Rule accepted here, -1 for none
+} NfaState;
+
+typedef struct {
+    int start;
+    int end;            // Has no edges until the fragment is joined to another
+} Fragment;
+
+typedef struct {
+    char *pattern;      // As written, for the comment next to the rule
+    int skip;
+    int parts;
+    char *types[MAX_PARTS];
+    int lengths[MAX_PARTS];     // 0 for the part that takes the rest of the match
+    int start;                  // NFA state the rule starts in
+} Rule;
+
+typedef struct {
+    char *name;
+    char *pattern;
+} Definition;
+
+static NfaState *nfa;
+static int nfa_count, nfa_capacity;
+static ByteSet *sets;
+static int set_count, set_capacity;
+static Rule *rules;
+static int rule_count, rule_capacity;
+static Definition *definitions;
+static int definition_count, definition_capacity;
+
+static const char *spec_path;
+static int spec_line;
+
+static void *grow(void *array, int *capacity, int count, size_t size) {
+    if (count < *capacity) {
+        return array;
+    }
+    *capacity = *capacity ? *capacity * 2 : 64;
+    array = realloc(array, size * *capacity);
+    if (!array) {
+        perror("Failed to allocate memory for generator");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+static char *copy_text(const char *text, size_t length) {
+    char *copy = malloc(length + 1);
+    if (!copy) {
+        perror("Failed to allocate memory for generator");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static void fail(const char *message, const char *detail) {
+    fprintf(stderr, "%s:%d: %s%s%s\n", spec_path, spec_line, message, detail ? ": " : "", detail ? detail : "");
+    exit(EXIT_FAILURE);
+}
+
+static void set_add(ByteSet *set, int byte) {
+    set->bits[byte >> 3] |= (unsigned char)(1 << (byte & 7));
+}
+
+static int set_has(const ByteSet *set, int byte) {
+    return (set->bits[byte >> 3] >> (byte & 7)) & 1;
+}
+
+static int new_state(void) {
+    nfa = grow(nfa, &nfa_capacity, nfa_count, sizeof(NfaState));
+    NfaState *state = &nfa[nfa_count];
+    state->epsilon[0] = state->epsilon[1] = -1;
+    state->next = -1;
+    state->set = -1;
+    state->accept = -1;
+    return nfa_count++;
+}
+
+static void add_epsilon(int from, int to) {
+    int slot = nfa[from].epsilon[0] < 0 ? 0 : 1;
+    nfa[from].epsilon[slot] = to;
+}
+
+static Fragment byte_fragment(const ByteSet *set) {
+    sets = grow(sets, &set_capacity, set_count, sizeof(ByteSet));
+    sets[set_count] = *set;
+
+    Fragment f = {new_state(), new_state()};
+    nfa[f.start].next = f.end;
+    nfa[f.start].set = set_count++;
+    return f;
+}
+
+static Fragment empty_fragment(void) {
+    int state = new_state();
+    Fragment f = {state, state};
+    return f;
+}
+
+static Fragment concat(Fragment a, Fragment b) {
+    add_epsilon(a.end, b.start);
+    Fragment f = {a.start, b.end};
+    return f;
+}
+
+static Fragment alternate(Fragment a, Fragment b) {
+    Fragment f = {new_state(), new_state()};
+    add_epsilon(f.start, a.start);
+    add_epsilon(f.start, b.start);
+    add_epsilon(a.end, f.end);
+    add_epsilon(b.end, f.end);
+    return f;
+}
+
+// '*', '+' or '?' applied to a fragment
+static Fragment repeat(Fragment a, char op) {
+    Fragment f = {new_state(), new_state()};
+    add_epsilon(f.start, a.start);
+    if (op != '+') {
+        add_epsilon(f.start, f.end);
+    }
+    if (op != '?') {
+        add_epsilon(a.end, a.start);
+    }
+    add_epsilon(a.end, f.end);
+    return f;
+}
+
+// ---- Pattern parser ----
+
+static const char *cursor;
+
+static const char *find_definition(const char *name, size_t length) {
+    for (int i = 0; i < definition_count; i++) {
+        if (strlen(definitions[i].name) == length && strncmp(definitions[i].name, name, length) == 0) {
+            return definitions[i].pattern;
+        }
+    }
+    return NULL;
+}
+
+// Escaped byte after a backslash
+static int parse_escape(void) {
+    char ch = *cursor++;
+    switch (ch) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'v': return '\v';
+        case 'f': return '\f';
+        case 'r': return '\r';
+        case 'x': {
+            if (!isxdigit((unsigned char)cursor[0]) || !isxdigit((unsigned char)cursor[1])) {
+                fail("\\x needs two hex digits", NULL);
+            }
+            char hex[3] = {cursor[0], cursor[1], '\0'};
+            cursor += 2;
+            return (int)strtol(hex, NULL, 16);
+        }
+        case '\0':
+            fail("Pattern ends in a backslash", NULL);
+            return 0;
+        default:
+            if (isalnum((unsigned char)ch)) {
+                fail("Unknown escape", NULL);
+            }
+            return (unsigned char)ch;
+    }
+}
+
+static void parse_class_into(ByteSet *set);
+
+// {name} inside a class: the definition must itself be a class or a single byte
+static void add_named_class(ByteSet *set) {
+    const char *end = strchr(cursor, '}');
+    if (!end) {
+        fail("Unclosed {name}", NULL);
+    }
+    const char *pattern = find_definition(cursor, end - cursor);
+    if (!pattern) {
+        fail("Unknown name", copy_text(cursor, end - cursor));
+    }
+
+    cursor = pattern;
+    if (*cursor == '[') {
+        cursor++;
+        parse_class_into(set);
+    } else {
+        set_add(set, *cursor == '\\' ? (cursor++, parse_escape()) : (unsigned char)*cursor++);
+    }
+    if (*cursor != '\0') {
+        fail("Name used in a class is not a class", pattern);
+    }
+    cursor = end + 1;
+}
+
+// Body of [ ... ] after the opening bracket, up to and including the closing one
+static void parse_class_into(ByteSet *set) {
+    ByteSet members = {{0}};
+    int negate = 0;
+
+    if (*cursor == '^') {
+        negate = 1;
+        cursor++;
+    }
+
+    while (*cursor != ']') {
+        if (*cursor == '\0') {
+            fail("Unclosed [", NULL);
+        }
+        if (*cursor == '{') {
+            cursor++;
+            add_named_class(&members);
+            continue;
+        }
+
+        int low = *cursor == '\\' ? (cursor++, parse_escape()) : (unsigned char)*cursor++;
+        int high = low;
+        if (cursor[0] == '-' && cursor[1] != ']' && cursor[1] != '\0') {
+            cursor++;
+            high = *cursor == '\\' ? (cursor++, parse_escape()) : (unsigned char)*cursor++;
+        }
+        for (int byte = low; byte <= high; byte++) {
+            set_add(&members, byte);
+        }
+    }
+    cursor++; // ']'
+
+    for (int byte = 0; byte < 256; byte++) {
+        if (set_has(&members, byte) != negate) {
+            set_add(set, byte);
+        }
+    }
+}
+
+static Fragment parse_alternation(void);
+
+static Fragment parse_atom(void) {
+    ByteSet set = {{0}};
+    char ch = *cursor++;
+
+    switch (ch) {
+        case '(': {
+            Fragment f = parse_alternation();
+            if (*cursor++ != ')') {
+                fail("Unclosed (", NULL);
+            }
+            return f;
+        }
+
+        case '[':
+            parse_class_into(&set);
+            return byte_fragment(&set);
+
+        case '.':
+            memset(&set, 0xff, sizeof(set));
+            return byte_fragment(&set);
+
+        case '{': {
+            const char *end = strchr(cursor, '}');
+            if (!end) {
+                fail("Unclosed {name}", NULL);
+            }
+            const char *pattern = find_definition(cursor, end - cursor);
+            if (!pattern) {
+                fail("Unknown name", copy_text(cursor, end - cursor));
+            }
+            const char *resume = end + 1;
+            cursor = pattern;
+            Fragment f = parse_alternation();
+            if (*cursor != '\0') {
+                fail("Unbalanced pattern in definition", pattern);
+            }
+            cursor = resume;
+            return f;
+        }
+
+        case '\\':
+            set_add(&set, parse_escape());
+            return byte_fragment(&set);
+
+        case '*': case '+': case '?': case '|': case ')': case '\0':
+            fail("Misplaced operator", NULL);
+            return empty_fragment();
+
+        default:
+            set_add(&set, (unsigned char)ch);
+            return byte_fragment(&set);
+    }
+}
+
+static Fragment parse_repeat(void) {
+    Fragment f = parse_atom();
+    while (*cursor == '*' || *cursor == '+' || *cursor == '?') {
+        f = repeat(f, *cursor++);
+    }
+    return f;
+}
+
+static Fragment parse_sequence(void) {
+    Fragment f = empty_fragment();
+    while (*cursor != '\0' && *cursor != '|' && *cursor != ')') {
+        f = concat(f, parse_repeat());
+    }
+    return f;
+}
+
+static Fragment parse_alternation(void) {
+    Fragment f = parse_sequence();
+    while (*cursor == '|') {
+        cursor++;
+        f = alternate(f, parse_sequence());
+    }
+    return f;
+}
+
+static Fragment parse_pattern(const char *pattern) {
+    cursor = pattern;
+    Fragment f = parse_alternation();
+    if (*cursor != '\0') {
+        fail("Unbalanced )", pattern);
+    }
+    return f;
+}
+
+// ---- Specification ----
+
+static Rule *new_rule(const char *pattern, int start, int end) {
+    rules = grow(rules, &rule_capacity, rule_count, sizeof(Rule));
+    Rule *rule = &rules[rule_count];
+    memset(rule, 0, sizeof(*rule));
+    rule->pattern = copy_text(pattern, strlen(pattern));
+    rule->start = start;
+    nfa[end].accept = rule_count++;
+    return rule;
+}
+
+static void add_keywords(void) {
+    for (size_t i = 0; i < WORD_COUNT; i++) {
+        Fragment f = empty_fragment();
+        for (const char *p = words[i].spelling; *p; p++) {
+            ByteSet set = {{0}};
+            set_add(&set, (unsigned char)*p);
+            f = concat(f, byte_fragment(&set));
+        }
+
+        Rule *rule = new_rule(words[i].spelling, f.start, f.end);
+        rule->parts = 1;
+        rule->types[0] = copy_text(words[i].type, strlen(words[i].type));
+    }
+}
+
+// "TYPE", "TYPE/n" or "SKIP" separated by blanks
+static void parse_actions(Rule *rule, const char *text) {
+    int variable = 0;
+
+    while (*text) {
+        while (*text == ' ' || *text == '\t') {
+            text++;
+        }
+        if (*text == '\0') {
+            break;
+        }
+
+        size_t length = strcspn(text, " \t/");
+        if (length == 4 && strncmp(text, "SKIP", 4) == 0) {
+            rule->skip = 1;
+            text += length;
+            continue;
+        }
+        if (rule->parts == MAX_PARTS) {
+            fail("Too many parts", NULL);
+        }
+
+        rule->types[rule->parts] = copy_text(text, length);
+        text += length;
+        if (*text == '/') {
+            rule->lengths[rule->parts] = (int)strtol(text + 1, (char **)&text, 10);
+            if (rule->lengths[rule->parts] <= 0) {
+                fail("Part length must be positive", NULL);
+            }
+        } else if (variable++) {
+            fail("Only one part may take the rest of the match", NULL);
+        }
+        rule->parts++;
+    }
+
+    if (rule->skip == (rule->parts > 0)) {
+        fail("A rule needs either SKIP or token types", NULL);
+    }
+}
+
+static void read_spec(FILE *in) {
+    char line[MAX_LINE];
+
+    while (fgets(line, sizeof(line), in)) {
+        spec_line++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] == '\0' || strncmp(line, "//", 2) == 0) {
+            continue;
+        }
+        if (strcmp(line, "@keywords") == 0) {
+            add_keywords();
+            continue;
+        }
+
+        // The pattern ends at the first blank outside [ ]
+        char *p = line;
+        int in_class = 0;
+        while (*p && (in_class || (*p != ' ' && *p != '\t'))) {
+            if (*p == '\\' && p[1]) {
+                p++;
+            } else if (*p == '[') {
+                in_class = 1;
+            } else if (*p == ']') {
+                in_class = 0;
+            }
+            p++;
+        }
+        char *pattern = copy_text(line, p - line);
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+
+        // name = pattern
+        if (*p == '=' && (p[1] == ' ' || p[1] == '\t')) {
+            char *value = p + 1;
+            while (*value == ' ' || *value == '\t') {
+                value++;
+            }
+            definitions = grow(definitions, &definition_capacity, definition_count, sizeof(Definition));
+            definitions[definition_count].name = pattern;
+            definitions[definition_count].pattern = copy_text(value, strlen(value));
+            definition_count++;
+            continue;
+        }
+
+        if (*p == '\0') {
+            fail("Rule has no action", pattern);
+        }
+        Fragment f = parse_pattern(pattern);
+        Rule *rule = new_rule(pattern, f.start, f.end);
+        parse_actions(rule, p);
+        free(pattern);
+    }
+}
+
+// ---- Subset construction ----
+
+static int class_of[256];
+static int class_count;
+static int class_byte[256];     // One byte of each class
+
+// Bytes belong to the same class when every set either holds both or neither
+static void build_classes(void) {
+    class_count = 0;
+    for (int byte = 0; byte < 256; byte++) {
+        int found = -1;
+        for (int c = 0; c < class_count && found < 0; c++) {
+            int other = class_byte[c];
+            int same = 1;
+            for (int s = 0; s < set_count && same; s++) {
+                same = set_has(&sets[s], byte) == set_has(&sets[s], other);
+            }
+            if (same) {
+                found = c;
+            }
+        }
+        if (found < 0) {
+            found = class_count;
+            class_byte[class_count++] = byte;
+        }
+        class_of[byte] = found;
+    }
+}
+
+typedef struct {
+    unsigned char *members;     // Bitmap of NFA states
+    int *next;                  // Per class
+    int accept;
+} DfaState;
+
+static DfaState *dfa;
+static int dfa_count, dfa_capacity;
+static int set_bytes;
+
+static void closure(unsigned char *members) {
+    int *stack = malloc(sizeof(int) * nfa_count * 2 + sizeof(int));
+    int top = 0;
+    if (!stack) {
+        perror("Failed to allocate memory for generator");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int s = 0; s < nfa_count; s++) {
+        if (members[s >> 3] & (1 << (s & 7))) {
+            stack[top++] = s;
+        }
+    }
+    while (top > 0) {
+        int s = stack[--top];
+        for (int e = 0; e < 2; e++) {
+            int t = nfa[s].epsilon[e];
+            if (t >= 0 && !(members[t >> 3] & (1 << (t & 7)))) {
+                members[t >> 3] |= (unsigned char)(1 << (t & 7));
+                stack[top++] = t;
+            }
+        }
+    }
+    free(stack);
+}
+
+// DFA state for a set of NFA states, added when new; takes ownership of 'members'
+static int dfa_state(unsigned char *members) {
+    for (int i = 0; i < dfa_count; i++) {
+        if (memcmp(dfa[i].members, members, set_bytes) == 0) {
+            free(members);
+            return i;
+        }
+    }
+
+    dfa = grow(dfa, &dfa_capacity, dfa_count, sizeof(DfaState));
+    DfaState *state = &dfa[dfa_count];
+    state->members = members;
+    state->next = NULL;
+    state->accept = -1;
+    for (int s = 0; s < nfa_count; s++) {
+        if ((members[s >> 3] & (1 << (s & 7))) && nfa[s].accept >= 0 &&
+            (state->accept < 0 || nfa[s].accept < state->accept)) {
+            state->accept = nfa[s].accept; // Rules listed first win
+        }
+    }
+    return dfa_count++;
+}
+
+static void build_dfa(void) {
+    set_bytes = (nfa_count + 7) / 8;
+
+    dfa_state(calloc(set_bytes, 1)); // 0: dead
+    unsigned char *start = calloc(set_bytes, 1);
+    for (int r = 0; r < rule_count; r++) {
+        start[rules[r].start >> 3] |= (unsigned char)(1 << (rules[r].start & 7));
+    }
+    closure(start);
+    dfa_state(start); // 1: start
+
+    for (int i = 0; i < dfa_count; i++) {
+        int *next = malloc(sizeof(int) * class_count);
+        if (!next) {
+            perror("Failed to allocate memory for generator");
+            exit(EXIT_FAILURE);
+        }
+        for (int c = 0; c < class_count; c++) {
+            unsigned char *moved = calloc(set_bytes, 1);
+            for (int s = 0; s < nfa_count; s++) {
+                if ((dfa[i].members[s >> 3] & (1 << (s & 7))) && nfa[s].next >= 0 &&
+                    set_has(&sets[nfa[s].set], class_byte[c])) {
+                    moved[nfa[s].next >> 3] |= (unsigned char)(1 << (nfa[s].next & 7));
+                }
+            }
+            closure(moved);
+            next[c] = dfa_state(moved); // May move dfa
+        }
+        dfa[i].next = next;
+    }
+}
+
+// ---- Minimization ----
+
+static int *group;      // Group of every DFA state
+static int group_count;
+
+// Moore's algorithm: split groups until states in a group agree on the group of every successor
+static void minimize(void) {
+    group = malloc(sizeof(int) * dfa_count);
+    int *signature = malloc(sizeof(int) * (class_count + 1) * dfa_count);
+    int *renumber = malloc(sizeof(int) * dfa_count);
+    if (!group || !signature || !renumber) {
+        perror("Failed to allocate memory for generator");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < dfa_count; i++) {
+        group[i] = dfa[i].accept + 1;
+    }
+
+    for (int previous = -1; previous != group_count;) {
+        previous = group_count;
+
+        for (int i = 0; i < dfa_count; i++) {
+            int *row = &signature[i * (class_count + 1)];
+            row[0] = group[i];
+            for (int c = 0; c < class_count; c++) {
+                row[c + 1] = group[dfa[i].next[c]];
+            }
+        }
+
+        group_count = 0;
+        for (int i = 0; i < dfa_count; i++) {
+            renumber[i] = -1;
+            for (int j = 0; j < i && renumber[i] < 0; j++) {
+                if (memcmp(&signature[i * (class_count + 1)], &signature[j * (class_count + 1)],
+                           sizeof(int) * (class_count + 1)) == 0) {
+                    renumber[i] = renumber[j];
+                }
+            }
+            if (renumber[i] < 0) {
+                renumber[i] = group_count++;
+            }
+        }
+        memcpy(group, renumber, sizeof(int) * dfa_count);
+    }
+
+    free(signature);
+    free(renumber);
+}
+
+// ---- Output ----
+
+static int state_count;
+static int *state_of_group;     // Output number of every group, dead first and start second
+static int *group_member;       // One DFA state of every output state
+
+static void number_states(void) {
+    state_of_group = malloc(sizeof(int) * dfa_count); // Never more groups than states
+    group_member = malloc(sizeof(int) * dfa_count);
+    if (!state_of_group || !group_member) {
+        perror("Failed to allocate memory for generator");
+        exit(EXIT_FAILURE);
+    }
+    for (int g = 0; g < group_count; g++) {
+        state_of_group[g] = -1;
+    }
+
+    // Breadth first from dead and start, so related states sit close together
+    int queue_head = 0;
+    int roots[2] = {0, 1};
+    state_count = 0;
+    for (int r = 0; r < 2; r++) {
+        if (state_of_group[group[roots[r]]] < 0) {
+            state_of_group[group[roots[r]]] = state_count;
+            group_member[state_count++] = roots[r];
+        }
+    }
+    while (queue_head < state_count) {
+        int i = group_member[queue_head++];
+        for (int c = 0; c < class_count; c++) {
+            int g = group[dfa[i].next[c]];
+            if (state_of_group[g] < 0) {
+                state_of_group[g] = state_count;
+                group_member[state_count++] = dfa[i].next[c];
+            }
+        }
+    }
+}
+
+// ---- Backtracking bound ----
+
+static int max_rescan;          // Most bytes lex_dfa reads past a match before it gives up on a longer one
+
+static int next_state(int s, int c) {
+    return state_of_group[group[dfa[group_member[s]].next[c]]];
+}
+
+static int accepts(int s) {
+    return dfa[group_member[s]].accept >= 0;
+}
+
+/* Longest run of bytes that only passes through live states accepting
+   nothing, starting from 's'. lex_dfa reads such a run and then goes back to
+   the last match, so a cycle of them would let one token rescan the rest of
+   the input and make the lexer quadratic: the spec is rejected instead. */
+static int rescan_from(int s, int *depth) {
+    if (depth[s] == -2) {
+        fprintf(stderr, "%s: a run of input can loop through states that accept nothing; "
+                "add a rule for its prefixes so lex_dfa never rescans it\n", spec_path);
+        exit(EXIT_FAILURE);
+    }
+    if (depth[s] >= 0) {
+        return depth[s];
+    }
+
+    depth[s] = -2; // On the current path
+    int longest = 0;
+    for (int c = 0; c < class_count; c++) {
+        int t = next_state(s, c);
+        if (t != 0 && !accepts(t)) {
+            int length = 1 + rescan_from(t, depth);
+            if (length > longest) {
+                longest = length;
+            }
+        }
+    }
+    depth[s] = longest;
+    return longest;
+}
+
+static void check_rescan(void) {
+    int *depth = malloc(sizeof(int) * state_count);
+    if (!depth) {
+        perror("Failed to allocate memory for generator");
+        exit(EXIT_FAILURE);
+    }
+    for (int s = 0; s < state_count; s++) {
+        depth[s] = -1;
+    }
+
+    max_rescan = 0;
+    for (int s = 1; s < state_count; s++) {
+        int length = rescan_from(s, depth);
+        if (length > max_rescan) {
+            max_rescan = length;
+        }
+    }
+    free(depth);
+}
+
+static void write_c_string(FILE *out, const char *text) {
+    for (; *text; text++) {
+        if (*text == '*' && text[1] == '/') {
+            fputs("*\\/", out); // Keep the comment closed where we close it
+            text++;
+        } else if ((unsigned char)*text < 0x20) {
+            fputc(' ', out);
+        } else {
+            fputc(*text, out);
+        }
+    }
+}
+
+static int write_header(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        perror("Failed to create output file");
+        return -1;
+    }
+
+    const char *state_type = state_count <= 256 ? "unsigned char" : "unsigned short";
+    const char *accept_type = rule_count < 128 ? "signed char" : "short";
+
+    fprintf(out, "// Generated by tools/dfa_gen from table/tokens.spec and buzz/keywords.def. Do not edit.\n");
+    fprintf(out, "// Included by buzz/dfa.c after the DfaRule typedef.\n\n");
+    fprintf(out, "#define DFA_STATES %d\n", state_count);
+    fprintf(out, "#define DFA_CLASSES %d\n", class_count);
+    fprintf(out, "#define DFA_RULES %d\n", rule_count);
+    fprintf(out, "#define DFA_DEAD 0\n");
+    fprintf(out, "#define DFA_START %d\n\n", state_of_group[group[1]]);
+
+    fprintf(out, "// Column of every byte\nstatic const unsigned char dfa_class[256] = {");
+    for (int byte = 0; byte < 256; byte++) {
+        fprintf(out, "%s%d,", byte % 16 ? " " : "\n    ", class_of[byte]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "// Next state for every state and column\nstatic const %s dfa_next[DFA_STATES][DFA_CLASSES] = {\n", state_type);
+    for (int s = 0; s < state_count; s++) {
+        fprintf(out, "    {");
+        for (int c = 0; c < class_count; c++) {
+            fprintf(out, "%s%d", c ? ", " : "", state_of_group[group[dfa[group_member[s]].next[c]]]);
+        }
+        fprintf(out, "},\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "// Rule matched when the longest match ends in a state, -1 for none\nstatic const %s dfa_accept[DFA_STATES] = {", accept_type);
+    for (int s = 0; s < state_count; s++) {
+        fprintf(out, "%s%d,", s % 16 ? " " : "\n    ", dfa[group_member[s]].accept);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "// Tokens each rule stores: {type, length} parts, length 0 for the part that takes the rest\n");
+    fprintf(out, "static const DfaRule dfa_rules[DFA_RULES] = {\n");
+    for (int r = 0; r < rule_count; r++) {
+        fprintf(out, "    {%d, %d, {", rules[r].skip, rules[r].parts);
+        for (int p = 0; p < rules[r].parts; p++) {
+            fprintf(out, "%s{%s, %d}", p ? ", " : "", rules[r].types[p], rules[r].lengths[p]);
+        }
+        fprintf(out, "}}, /* ");
+        write_c_string(out, rules[r].pattern);
+        fprintf(out, " */\n");
+    }
+    fprintf(out, "};\n");
+
+    if (fclose(out) != 0) {
+        perror("Failed to write output file");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <tokens.spec> <dfa_table.h>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    spec_path = argv[1];
+    FILE *in = fopen(spec_path, "r");
+    if (!in) {
+        perror("Failed to open specification");
+        return EXIT_FAILURE;
+    }
+    read_spec(in);
+    fclose(in);
+
+    build_classes();
+    build_dfa();
+    minimize();
+    number_states();
+    check_rescan();
+
+    if (write_header(argv[2]) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    printf("%d rules, %d NFA states, %d DFA states, %d after minimizing, %d byte classes, %d byte(s) rescanned at most\n",
+           rule_count, nfa_count, dfa_count, state_count, class_count, max_rescan);
+    return EXIT_SUCCESS;
+}
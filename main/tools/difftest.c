@@ -0,0 +1,612 @@
+// Checks that every lexer engine emits exactly what the serial reference emits
+// (lexNext called in a loop over the whole buffer, as the lexer always ran):
+// same types, spellings and values, token for token. Lines and columns, worked
+// out from offsets, are checked against a byte-by-byte count by the token table
+// and by the line_index row (offset_to_line_col). Inputs are the
+// given files and directories (.bz files), generated programs and mutations
+// of both. The first divergence of each engine is printed and the input saved
+// as difftest-<engine>.bz; the summary shows each engine's speedup over the
+// reference. A small PARALLEL_MIN_CHUNK makes lex_parallel, and lex() which
+// reads the stream and hands it to lex_parallel, split even short inputs:
+//
+// gcc -O2 -pthread -DPARALLEL_MIN_CHUNK=256 tools/difftest.c buzz/lex.c buzz/symbols.c buzz/literal.c buzz/source.c buzz/parallel.c buzz/arena.c buzz/scan.c buzz/charclass.c buzz/tokentable.c buzz/incremental.c buzz/dfa.c buzz/lines.c -o difftest.exe
+// difftest.exe --generate 500 --mutations 20 samples
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "../buzz/lex.h"
+#include "../buzz/source.h"
+#include "../buzz/tokentable.h"
+#include "../buzz/incremental.h"
+#include "../buzz/dfa.h"
+#include "../buzz/literal.h"
+#include "../buzz/lines.h"
+
+// Tokens of one engine run, copied out so the engine's state can be released
+typedef struct {
+    Token *tokens;
+    size_t count;
+    unsigned int *lines;    // Position of every token, NULL when the engine reports none
+    unsigned int *columns;
+} TokenList;
+
+// Lex 'source' into 'out'; the FILE is the same bytes for engines that read streams
+typedef void (*Engine)(const char *source, size_t length, FILE *file, TokenList *out);
+
+static void keep_tokens(TokenList *out, const Token *tokens, size_t count) {
+    out->tokens = malloc(sizeof(Token) * (count + 1));
+    if (!out->tokens) {
+        perror("Failed to allocate memory for tokens");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(out->tokens, tokens, sizeof(Token) * count);
+    out->count = count;
+}
+
+static void alloc_positions(TokenList *out) {
+    out->lines = malloc(sizeof(unsigned int) * (out->count + 1));
+    out->columns = malloc(sizeof(unsigned int) * (out->count + 1));
+    if (!out->lines || !out->columns) {
+        perror("Failed to allocate memory for positions");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// The reference positions: every byte before a token looked at, the way the lexer once tracked them
+static void count_positions(const char *source, TokenList *list) {
+    unsigned int line = 1;
+    size_t line_start = 0, at = 0;
+
+    alloc_positions(list);
+    for (size_t i = 0; i < list->count; i++) {
+        for (; at < list->tokens[i].offset; at++) {
+            if (source[at] == '\n') {
+                line++;
+                line_start = at + 1;
+            }
+        }
+        list->lines[i] = line;
+        list->columns[i] = (unsigned int)(list->tokens[i].offset - line_start + 1);
+    }
+}
+
+// The expected tokens: no chunks, no iterator, no tables, just lexNext to the end of the buffer
+static void run_reference(const char *source, size_t length, FILE *file, TokenList *out) {
+    (void)file;
+    LexerState state;
+    size_t count;
+
+    lexer_init(&state, source, length);
+    lexer_start(&state);
+    while (lexNext(&state)) {
+        // Every group lands in the state's array
+    }
+    Token *tokens = lexer_finish(&state, &count);
+    keep_tokens(out, tokens, count);
+    lexer_free(&state);
+    count_positions(source, out);
+}
+
+static void run_lex(const char *source, size_t length, FILE *file, TokenList *out) {
+    (void)source;
+    (void)length;
+    LexerState state;
+    size_t count;
+    Token *tokens = lex(&state, file, &count);
+    keep_tokens(out, tokens, count);
+    lexer_free(&state);
+}
+
+static void run_line_index(const char *source, size_t length, FILE *file, TokenList *out) {
+    (void)file;
+    LexerState state;
+    LineIndex index;
+    size_t count;
+    Token *tokens = lex_buffer(&state, source, length, &count);
+    keep_tokens(out, tokens, count);
+    lexer_free(&state);
+
+    line_index_build(&index, source, length);
+    alloc_positions(out);
+    for (size_t i = 0; i < count; i++) {
+        offset_to_line_col(&index, out->tokens[i].offset, &out->lines[i], &out->columns[i]);
+    }
+    line_index_free(&index);
+}
+
+static void run_lex_buffer(const char *source, size_t length, FILE *file, TokenList *out) {
+    (void)file;
+    LexerState state;
+    size_t count;
+    Token *tokens = lex_buffer(&state, source, length, &count);
+    keep_tokens(out, tokens, count);
+    lexer_free(&state);
+}
+
+static void run_lex_dfa(const char *source, size_t length, FILE *file, TokenList *out) {
+    (void)file;
+    LexerState state;
+    size_t count;
+    Token *tokens = lex_dfa(&state, source, length, &count);
+    keep_tokens(out, tokens, count);
+    lexer_free(&state);
+}
+
+static void run_lex_parallel(const char *source, size_t length, FILE *file, TokenList *out) {
+    (void)file;
+    LexerState state;
+    size_t count;
+    Token *tokens = lex_parallel(&state, source, length, 4, &count);
+    keep_tokens(out, tokens, count);
+    lexer_free(&state);
+}
+
+static void run_lexer_next(const char *source, size_t length, FILE *file, TokenList *out) {
+    (void)file;
+    LexerState state;
+    Token token;
+    size_t capacity = 64;
+
+    out->tokens = malloc(sizeof(Token) * capacity);
+    out->count = 0;
+    lexer_init(&state, source, length);
+    while (out->tokens && lexer_next(&state, &token)) {
+        if (out->count == capacity) {
+            capacity *= 2;
+            out->tokens = realloc(out->tokens, sizeof(Token) * capacity);
+            if (!out->tokens) {
+                break;
+            }
+        }
+        out->tokens[out->count++] = token;
+    }
+    if (!out->tokens) {
+        perror("Failed to allocate memory for tokens");
+        exit(EXIT_FAILURE);
+    }
+    lexer_free(&state);
+}
+
+static void run_token_table(const char *source, size_t length, FILE *file, TokenList *out) {
+    (void)file;
+    LexerState state;
+    TokenTable table;
+
+    token_table_init(&table, TOKEN_TABLE_LINES | TOKEN_TABLE_SYMBOLS);
+    token_table_lex(&table, &state, source, length);
+    lexer_free(&state);
+
+    out->tokens = malloc(sizeof(Token) * (table.count + 1));
+    if (!out->tokens) {
+        perror("Failed to allocate memory for tokens");
+        exit(EXIT_FAILURE);
+    }
+    out->count = table.count;
+    alloc_positions(out);
+    for (size_t i = 0; i < table.count; i++) {
+        out->tokens[i].type = (TokenType)table.types[i];
+        out->tokens[i].offset = table.offsets[i];
+        out->tokens[i].length = table.lengths[i];
+        out->lines[i] = table.lines[i];
+        out->columns[i] = table.columns[i];
+
+        // The table keeps no literal values: decode them like the token file reader does
+        Token *token = &out->tokens[i];
+        token->integer = 0;
+        if (token->type == VAR_IDENT || token->type == FUNC_IDENT) {
+            token->symbol = table.symbols[i];
+        } else if (token->type == INTEGER) {
+            literal_integer(source + token->offset, token->length, &token->integer);
+        } else if (token->type == FLOAT) {
+            literal_float(source + token->offset, token->length, &token->real);
+        }
+    }
+    token_table_free(&table);
+}
+
+// Copy 'source' without the bytes in [from, from + cut)
+static char *cut_out(const char *source, size_t length, size_t from, size_t cut) {
+    char *shorter = malloc(length - cut + 1);
+    if (!shorter) {
+        perror("Failed to allocate memory for input");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(shorter, source, from);
+    memcpy(shorter + from, source + from + cut, length - from - cut);
+    return shorter;
+}
+
+/* Lex the input with its second and fourth fifths cut out, then let two
+   lex_edit calls put them back, the later one first so the second edit
+   lands in front of tokens the first one moved. A document keeps the
+   symbol IDs of names it saw before, so IDs are renumbered by first
+   appearance before comparing. */
+static void run_lex_edit(const char *source, size_t length, FILE *file, TokenList *out) {
+    (void)file;
+    size_t fifth = length / 5;
+    char *one_cut = cut_out(source, length, fifth, fifth);
+    char *two_cuts = cut_out(one_cut, length - fifth, 2 * fifth, fifth);
+
+    LexDocument document;
+    lex_document_open(&document, two_cuts, length - 2 * fifth);
+    LexEdit later = {2 * fifth, 0, fifth};
+    lex_edit(&document, one_cut, length - fifth, &later);
+    LexEdit earlier = {fifth, 0, fifth};
+    lex_edit(&document, source, length, &earlier);
+    out->tokens = lex_document_tokens(&document, &out->count);
+
+    uint32_t symbol_count = document.state.symbols.count;
+    uint32_t *renumbered = malloc(sizeof(uint32_t) * (symbol_count + 1));
+    if (!renumbered) {
+        perror("Failed to allocate memory for symbols");
+        exit(EXIT_FAILURE);
+    }
+    memset(renumbered, 0xff, sizeof(uint32_t) * (symbol_count + 1));
+    uint32_t next = 0;
+    for (size_t i = 0; i < out->count; i++) {
+        Token *token = &out->tokens[i];
+        if (token->type == VAR_IDENT || token->type == FUNC_IDENT) {
+            if (renumbered[token->symbol] == SYMBOL_NONE) {
+                renumbered[token->symbol] = next++;
+            }
+            token->symbol = renumbered[token->symbol];
+        }
+    }
+
+    free(renumbered);
+    lex_document_free(&document);
+    free(two_cuts);
+    free(one_cut);
+}
+
+static const struct {
+    const char *name;
+    Engine run;
+} engines[] = {
+    {"lex", run_lex},
+    {"lex_buffer", run_lex_buffer},
+    {"lex_parallel", run_lex_parallel},
+    {"lexer_next", run_lexer_next},
+    {"token_table", run_token_table},
+    {"lex_edit", run_lex_edit},
+    {"lex_dfa", run_lex_dfa},
+    {"line_index", run_line_index},
+};
+
+#define ENGINE_COUNT (sizeof(engines) / sizeof(engines[0]))
+
+typedef struct {
+    size_t inputs;
+    size_t diverged;
+    double seconds;
+} EngineResult;
+
+static EngineResult results[ENGINE_COUNT];
+static double reference_seconds;
+static size_t input_count;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+// xorshift64*: the same seed reproduces the same inputs everywhere
+static unsigned int random_below(unsigned int bound) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (unsigned int)((rng_state * 0x2545F4914F6CDD1DULL) >> 32) % bound;
+}
+
+// Pieces for generated programs and for dictionary mutations: odd cases first
+static const char *pieces[] = {
+    "returnvalue", "return", "<|", ":>", "<| comment\n spans :: lines :>", "++", "--", "~fn", "#var1",
+    "~1x", "#", "1.2.3", "3.5", "12", "abc1", "$", "\xe9t\xe9", "\r\n", "\t \r\x0b\x0c", "buzz", "if",
+    "(", ")", "+", "//", "&&", "||", "&", "|", "!=", "<=", "<", ":", ">", "x", "\n", " ", "\n\n"
+};
+
+#define PIECE_COUNT (sizeof(pieces) / sizeof(pieces[0]))
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} Input;
+
+static void input_reserve(Input *input, size_t needed) {
+    if (needed <= input->capacity && input->data) {
+        return;
+    }
+    size_t capacity = input->capacity ? input->capacity : 256;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    input->data = realloc(input->data, capacity);
+    if (!input->data) {
+        perror("Failed to allocate memory for input");
+        exit(EXIT_FAILURE);
+    }
+    input->capacity = capacity;
+}
+
+static void input_insert(Input *input, size_t at, const char *text, size_t length) {
+    input_reserve(input, input->length + length);
+    memmove(input->data + at + length, input->data + at, input->length - at);
+    memcpy(input->data + at, text, length);
+    input->length += length;
+}
+
+static void generate(Input *input, unsigned int pieces_wanted) {
+    input->length = 0;
+    for (unsigned int i = 0; i < pieces_wanted; i++) {
+        const char *piece = pieces[random_below(PIECE_COUNT)];
+        input_insert(input, input->length, piece, strlen(piece));
+        if (random_below(2) == 0) {
+            input_insert(input, input->length, random_below(2) ? " " : "\n", 1);
+        }
+    }
+}
+
+// One libFuzzer-style mutation: flip a bit, change, insert, erase or duplicate bytes, or splice in a piece
+static void mutate(Input *input) {
+    size_t at = input->length ? random_below((unsigned int)input->length) : 0;
+
+    switch (input->length ? random_below(6) : 2) {
+        case 0:
+            input->data[at] ^= (char)(1 << random_below(8));
+            break;
+
+        case 1:
+            input->data[at] = (char)random_below(256);
+            break;
+
+        case 2: {
+            char byte = (char)random_below(256);
+            input_insert(input, at, &byte, 1);
+            break;
+        }
+
+        case 3: {
+            size_t length = 1 + random_below(8);
+            if (length > input->length - at) {
+                length = input->length - at;
+            }
+            memmove(input->data + at, input->data + at + length, input->length - at - length);
+            input->length -= length;
+            break;
+        }
+
+        case 4: {
+            size_t length = 1 + random_below(16);
+            if (length > input->length - at) {
+                length = input->length - at;
+            }
+            char copy[16];
+            memcpy(copy, input->data + at, length);
+            input_insert(input, random_below((unsigned int)input->length + 1), copy, length);
+            break;
+        }
+
+        default: {
+            const char *piece = pieces[random_below(PIECE_COUNT)];
+            input_insert(input, at, piece, strlen(piece));
+            break;
+        }
+    }
+}
+
+static void save_input(const char *engine, const char *data, size_t length) {
+    char path[64];
+    snprintf(path, sizeof(path), "difftest-%s.bz", engine);
+    FILE *out = fopen(path, "wb");
+    if (out) {
+        fwrite(data, 1, length, out);
+        fclose(out);
+    }
+}
+
+static void print_token(const char *label, const char *source, const TokenList *list, size_t index) {
+    if (index >= list->count) {
+        printf("  %-9s (no more tokens, %zu in total)\n", label, list->count);
+        return;
+    }
+    const Token *token = &list->tokens[index];
+    printf("  %-9s %-16s '%.*s' at offset %zu", label, token_name(token->type),
+           (int)token->length, source + token->offset, token->offset);
+    if (list->lines) {
+        printf(", %u:%u", list->lines[index], list->columns[index]);
+    }
+    if (token->type == VAR_IDENT || token->type == FUNC_IDENT) {
+        printf(", symbol %u", token->symbol);
+    } else if (token->type == INTEGER) {
+        printf(", value %llu", (unsigned long long)token->integer);
+    } else if (token->type == FLOAT) {
+        printf(", value %.17g", token->real);
+    }
+    printf("\n");
+}
+
+// Index of the first token that differs, or SIZE_MAX when the lists are identical
+static size_t first_difference(const TokenList *expected, const TokenList *actual) {
+    size_t count = expected->count < actual->count ? expected->count : actual->count;
+
+    for (size_t i = 0; i < count; i++) {
+        const Token *a = &expected->tokens[i];
+        const Token *b = &actual->tokens[i];
+        if (a->type != b->type || a->offset != b->offset || a->length != b->length ||
+            a->integer != b->integer) { // Whole value union
+            return i;
+        }
+        if (expected->lines && actual->lines &&
+            (expected->lines[i] != actual->lines[i] || expected->columns[i] != actual->columns[i])) {
+            return i;
+        }
+    }
+    return expected->count == actual->count ? (size_t)-1 : count;
+}
+
+// Run the reference and every engine on one input; 0 if all agree
+static int check_input(const char *name, const char *data, size_t length) {
+    FILE *file = tmpfile();
+    if (!file || (length > 0 && fwrite(data, 1, length, file) != length)) {
+        perror("Failed to write temporary input");
+        exit(EXIT_FAILURE);
+    }
+
+    TokenList expected = {0};
+    double start = now_seconds();
+    run_reference(data, length, NULL, &expected);
+    reference_seconds += now_seconds() - start;
+    input_count++;
+
+    int status = 0;
+    for (size_t e = 0; e < ENGINE_COUNT; e++) {
+        TokenList actual = {0};
+        start = now_seconds();
+        engines[e].run(data, length, file, &actual);
+        results[e].seconds += now_seconds() - start;
+        results[e].inputs++;
+
+        size_t index = first_difference(&expected, &actual);
+        if (index != (size_t)-1) {
+            if (results[e].diverged++ == 0) {
+                printf("%s diverges from the reference on %s (%zu bytes) at token %zu, input saved as difftest-%s.bz\n",
+                       engines[e].name, name, length, index, engines[e].name);
+                print_token("expected", data, &expected, index);
+                print_token("got", data, &actual, index);
+                save_input(engines[e].name, data, length);
+            }
+            status = -1;
+        }
+        free(actual.tokens);
+        free(actual.lines);
+        free(actual.columns);
+    }
+
+    fclose(file);
+    free(expected.tokens);
+    free(expected.lines);
+    free(expected.columns);
+    return status;
+}
+
+// Check a file and 'mutations' mutants of it
+static void check_with_mutants(const char *name, Input *input, int mutations) {
+    Input mutant = {0};
+
+    check_input(name, input->data, input->length);
+    for (int i = 0; i < mutations; i++) {
+        mutant.length = 0;
+        input_insert(&mutant, 0, input->data, input->length);
+        for (unsigned int steps = 1 + random_below(4); steps > 0; steps--) {
+            mutate(&mutant);
+        }
+
+        char mutant_name[512];
+        snprintf(mutant_name, sizeof(mutant_name), "mutant %d of %s", i + 1, name);
+        check_input(mutant_name, mutant.data, mutant.length);
+    }
+
+    free(mutant.data);
+}
+
+static void check_path(const char *path, int mutations, int top_level) {
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        fprintf(stderr, "Error: Unable to open file '%s'.\n", path);
+        return;
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+        DIR *handle = opendir(path);
+        struct dirent *entry;
+        while (handle && (entry = readdir(handle)) != NULL) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            char child[4096];
+            snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+            check_path(child, mutations, 0);
+        }
+        if (handle) {
+            closedir(handle);
+        }
+        return;
+    }
+
+    // Inside directories only .bz files count; files named outright are always checked
+    const char *dot = strrchr(path, '.');
+    if (!top_level && (!dot || strcmp(dot, ".bz") != 0)) {
+        return;
+    }
+
+    SourceBuffer source;
+    if (source_open(&source, path) != 0) {
+        fprintf(stderr, "Error: Unable to open file '%s'.\n", path);
+        return;
+    }
+
+    Input input = {0};
+    input_insert(&input, 0, source.data, source.length);
+    source_close(&source);
+    check_with_mutants(path, &input, mutations);
+    free(input.data);
+}
+
+int main(int argc, char *argv[]) {
+    int generated = 100, mutations = 10;
+    int arg = 1;
+
+    while (arg + 1 < argc && strncmp(argv[arg], "--", 2) == 0) {
+        if (strcmp(argv[arg], "--seed") == 0) {
+            rng_state ^= strtoull(argv[arg + 1], NULL, 10) * 0xBF58476D1CE4E5B9ULL;
+            if (rng_state == 0) {
+                rng_state = 1;
+            }
+        } else if (strcmp(argv[arg], "--generate") == 0) {
+            generated = atoi(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "--mutations") == 0) {
+            mutations = atoi(argv[arg + 1]);
+        } else {
+            fprintf(stderr, "Usage: %s [--seed <n>] [--generate <programs>] [--mutations <per input>] [file.bz | dir]...\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        arg += 2;
+    }
+
+    for (; arg < argc; arg++) {
+        check_path(argv[arg], mutations, 1);
+    }
+
+    Input input = {0};
+    for (int i = 0; i < generated; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "generated program %d", i + 1);
+        generate(&input, 1 + random_below(400));
+        check_with_mutants(name, &input, mutations);
+    }
+    free(input.data);
+
+    printf("\n%-14s %8s %9s %11s %11s %8s\n", "ENGINE", "INPUTS", "DIVERGED", "REF (s)", "ENGINE (s)", "SPEEDUP");
+    printf("----------------------------------------------------------------\n");
+    size_t diverged = 0;
+    for (size_t e = 0; e < ENGINE_COUNT; e++) {
+        printf("%-14s %8zu %9zu %11.4f %11.4f %7.2fx\n", engines[e].name, results[e].inputs, results[e].diverged,
+               reference_seconds, results[e].seconds,
+               results[e].seconds > 0 ? reference_seconds / results[e].seconds : 0.0);
+        diverged += results[e].diverged;
+    }
+    printf("%zu input(s) checked.\n", input_count);
+
+    return diverged == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,112 @@
+// Builds buzz/keyword_hash.h from buzz/keywords.def.
+// Searches for multipliers that give every word its own slot when hashed on
+// (first character, last character, length), so a lookup is one probe and one compare.
+//
+// gcc tools/keyword_gen.c -o keyword_gen && ./keyword_gen buzz/keyword_hash.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char *type;
+    const char *spelling;
+} Word;
+
+static const Word words[] = {
+#define KEYWORD(type, spelling) {#type, spelling},
+#include "../buzz/keywords.def"
+};
+
+#define WORD_COUNT (sizeof(words) / sizeof(words[0]))
+
+static unsigned int hash(unsigned int first_mul, unsigned int last_mul, unsigned int size, const char *word) {
+    size_t length = strlen(word);
+    unsigned int first = (unsigned char)word[0];
+    unsigned int last = (unsigned char)word[length - 1];
+    return (first * first_mul + last * last_mul + (unsigned int)length) & (size - 1);
+}
+
+// Try every multiplier pair for one table size; 1 and the pair when none of the words collide
+static int search(unsigned int size, unsigned int *first_mul, unsigned int *last_mul) {
+    int *used = malloc(sizeof(int) * size);
+    if (!used) {
+        perror("Failed to allocate memory for hash search");
+        exit(EXIT_FAILURE);
+    }
+
+    for (unsigned int a = 1; a < 256; a++) {
+        for (unsigned int b = 1; b < 256; b++) {
+            memset(used, 0, sizeof(int) * size);
+            size_t i;
+            for (i = 0; i < WORD_COUNT; i++) {
+                unsigned int slot = hash(a, b, size, words[i].spelling);
+                if (used[slot]) {
+                    break;
+                }
+                used[slot] = 1;
+            }
+            if (i == WORD_COUNT) {
+                *first_mul = a;
+                *last_mul = b;
+                free(used);
+                return 1;
+            }
+        }
+    }
+
+    free(used);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <keyword_hash.h>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    unsigned int size = 1, first_mul = 0, last_mul = 0;
+    while (size < WORD_COUNT) {
+        size *= 2;
+    }
+    while (!search(size, &first_mul, &last_mul)) {
+        size *= 2;
+        if (size > 4096) {
+            fprintf(stderr, "Error: No collision-free hash found; two words share first, last and length.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    const Word **slots = calloc(size, sizeof(Word *));
+    if (!slots) {
+        perror("Failed to allocate memory for hash table");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < WORD_COUNT; i++) {
+        slots[hash(first_mul, last_mul, size, words[i].spelling)] = &words[i];
+    }
+
+    FILE *out = fopen(argv[1], "w");
+    if (!out) {
+        fprintf(stderr, "Error: Unable to create file '%s'.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(out, "// Generated by tools/keyword_gen.c from keywords.def - do not edit\n\n");
+    fprintf(out, "#define KEYWORD_HASH_SIZE %u\n", size);
+    fprintf(out, "#define KEYWORD_HASH(first, last, length) \\\n");
+    fprintf(out, "    (((unsigned int)(first) * %uu + (unsigned int)(last) * %uu + (unsigned int)(length)) & (KEYWORD_HASH_SIZE - 1))\n\n",
+            first_mul, last_mul);
+    fprintf(out, "static const KeywordSlot keyword_hash[KEYWORD_HASH_SIZE] = {\n");
+    for (unsigned int i = 0; i < size; i++) {
+        if (slots[i]) {
+            fprintf(out, "    [%u] = {\"%s\", %zu, %s},\n", i, slots[i]->spelling, strlen(slots[i]->spelling), slots[i]->type);
+        }
+    }
+    fprintf(out, "};\n");
+
+    fclose(out);
+    free(slots);
+    printf("%zu words in %u slots (first * %u + last * %u + length).\n", WORD_COUNT, size, first_mul, last_mul);
+    return EXIT_SUCCESS;
+}
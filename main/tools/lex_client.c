@@ -0,0 +1,225 @@
+// Sends one .bz file to a running `main.exe --serve` and writes the tokens it returns,
+// in the same formats main.exe writes itself (a .bzt output gets the binary token file).
+//
+// gcc tools/lex_client.c -o lex_client.exe
+// lex_client.exe [--socket <path>] [--format table|jsonl|tsv] [--inline] <input_file.bz> <output_file.bz | output_file.bzt>
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../buzz/server.h"
+
+#define COPY_BUFFER (1 << 16)
+
+static int write_full(int fd, const void *data, size_t length) {
+    const char *p = data;
+
+    while (length > 0) {
+        ssize_t put = write(fd, p, length);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put <= 0) {
+            return -1;
+        }
+        p += put;
+        length -= (size_t)put;
+    }
+    return 0;
+}
+
+// The whole file, for --inline
+static char *read_file(const char *path, size_t *length) {
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        return NULL;
+    }
+
+    size_t capacity = COPY_BUFFER, used = 0, got;
+    char *data = malloc(capacity);
+    if (!data) {
+        perror("Failed to allocate memory for input");
+        exit(EXIT_FAILURE);
+    }
+    while ((got = fread(data + used, 1, capacity - used, in)) > 0) {
+        used += got;
+        if (used == capacity) {
+            capacity *= 2;
+            char *grown = realloc(data, capacity);
+            if (!grown) {
+                perror("Failed to allocate memory for input");
+                exit(EXIT_FAILURE);
+            }
+            data = grown;
+        }
+    }
+    fclose(in);
+
+    *length = used;
+    return data;
+}
+
+static int connect_server(const char *socket_path) {
+    struct sockaddr_un address;
+
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int parse_format(const char *name) {
+    if (strcmp(name, "table") == 0) {
+        return SERVER_TABLE;
+    } else if (strcmp(name, "jsonl") == 0) {
+        return SERVER_JSONL;
+    } else if (strcmp(name, "tsv") == 0) {
+        return SERVER_TSV;
+    }
+    return -1;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--socket <path>] [--format table|jsonl|tsv] [--inline] <input_file.bz> <output_file.bz | output_file.bzt>\n", program);
+}
+
+int main(int argc, char *argv[]) {
+    const char *socket_path = getenv(SERVER_SOCKET_VARIABLE);
+    int format = SERVER_TABLE;
+    int kind = SERVER_PATH;
+    int arg = 1;
+
+    if (!socket_path || !*socket_path) {
+        socket_path = SERVER_DEFAULT_SOCKET;
+    }
+
+    while (arg < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "--inline") == 0) {
+            kind = SERVER_INLINE;
+            arg++;
+        } else if (arg + 1 < argc && strcmp(argv[arg], "--socket") == 0) {
+            socket_path = argv[arg + 1];
+            arg += 2;
+        } else if (arg + 1 < argc && strcmp(argv[arg], "--format") == 0 && parse_format(argv[arg + 1]) > 0) {
+            format = parse_format(argv[arg + 1]);
+            arg += 2;
+        } else {
+            break;
+        }
+    }
+
+    if (argc - arg != 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *input = argv[arg];
+    const char *output = argv[arg + 1];
+    const char *dot = strrchr(output, '.');
+    if (dot && strcmp(dot, ".bzt") == 0) {
+        format = SERVER_TOKEN_FILE;
+    }
+
+    // The server opens paths itself, from its own working directory
+    char resolved[PATH_MAX];
+    char *payload;
+    size_t length;
+    if (kind == SERVER_PATH) {
+        if (!realpath(input, resolved)) {
+            fprintf(stderr, "Error: Unable to open file '%s'.\n", input);
+            return EXIT_FAILURE;
+        }
+        payload = resolved;
+        length = strlen(resolved);
+    } else if (!(payload = read_file(input, &length))) {
+        fprintf(stderr, "Error: Unable to open file '%s'.\n", input);
+        return EXIT_FAILURE;
+    }
+
+    int fd = connect_server(socket_path);
+    if (fd < 0) {
+        fprintf(stderr, "Error: No lexing server on '%s'.\n", socket_path);
+        return EXIT_FAILURE;
+    }
+
+    unsigned char request[SERVER_REQUEST_SIZE] = {0};
+    memcpy(request, SERVER_MAGIC, 4);
+    request[4] = SERVER_VERSION;
+    request[5] = (unsigned char)kind;
+    request[6] = (unsigned char)format;
+    server_put_u64(request + 8, length);
+    if (write_full(fd, request, sizeof(request)) != 0 || write_full(fd, payload, length) != 0) {
+        fprintf(stderr, "Error: Lost the connection to the server.\n");
+        return EXIT_FAILURE;
+    }
+    shutdown(fd, SHUT_WR);
+    if (kind == SERVER_INLINE) {
+        free(payload);
+    }
+
+    // The reply header, then everything up to the close is the body
+    unsigned char reply[SERVER_REPLY_SIZE];
+    size_t have = 0;
+    ssize_t got;
+    while (have < sizeof(reply) && (got = read(fd, reply + have, sizeof(reply) - have)) != 0) {
+        if (got < 0 && errno != EINTR) {
+            break;
+        }
+        have += got > 0 ? (size_t)got : 0;
+    }
+    if (have < sizeof(reply) || memcmp(reply, SERVER_MAGIC, 4) != 0 || reply[4] != SERVER_VERSION) {
+        fprintf(stderr, "Error: Malformed reply from the server.\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = reply[5] == SERVER_OK ? fopen(output, "wb") : stderr;
+    if (!out) {
+        fprintf(stderr, "Error: Unable to create output file '%s'.\n", output);
+        return EXIT_FAILURE;
+    }
+
+    char buffer[COPY_BUFFER];
+    int status = 0;
+    while ((got = read(fd, buffer, sizeof(buffer))) != 0) {
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 || fwrite(buffer, 1, (size_t)got, out) != (size_t)got) {
+            status = -1;
+            break;
+        }
+    }
+    close(fd);
+
+    if (reply[5] != SERVER_OK) {
+        return EXIT_FAILURE;
+    }
+    if (fclose(out) != 0 || status != 0) {
+        fprintf(stderr, "Error: Unable to write output file '%s'.\n", output);
+        return EXIT_FAILURE;
+    }
+
+    printf("Lexical analysis complete. Tokens written to '%s'.\n", output);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,38 @@
+// Prints a binary token file (.bzt) in the same TOKEN / TOKEN TYPE layout main.exe writes.
+//
+// gcc -pthread tools/token_dump.c buzz/tokenfile.c buzz/source.c buzz/lex.c buzz/symbols.c buzz/literal.c buzz/arena.c buzz/scan.c buzz/charclass.c buzz/lines.c buzz/parallel.c -o token_dump.exe
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../buzz/tokenfile.h"
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <tokens.bzt>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    TokenReader reader;
+    if (token_reader_open(&reader, argv[1]) != 0) {
+        fprintf(stderr, "Error: '%s' is not a token file.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-20s %-20s %s\n", "TOKEN", "TOKEN TYPE", "LINE:COLUMN");
+    printf("--------------------------------------------------------\n");
+
+    Token token;
+    const char *text;
+    int status;
+    while ((status = token_reader_next(&reader, &token, &text)) == 1) {
+        printf("%-20.*s %-20s %u:%u\n", (int)token.length, text, token_name(token.type), reader.line, reader.column);
+    }
+
+    token_reader_close(&reader);
+    if (status < 0) {
+        fprintf(stderr, "Error: '%s' is damaged.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}